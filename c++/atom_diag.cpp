@@ -31,16 +31,18 @@ using std::string;
 
 namespace cthyb {
 
-atom_diag::atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, std::vector<many_body_op_t> const& qn_vector)
+atom_diag::atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, std::vector<many_body_op_t> const& qn_vector,
+                     int n_threads)
    : h_atomic(h_), fops(fops) {
- atom_diag_worker{this}.partition_with_qn(qn_vector);
+ atom_diag_worker{this, n_threads}.partition_with_qn(qn_vector);
  complete_init();
 }
 
 //-----------------------------
 
-atom_diag::atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops) : h_atomic(h_), fops(fops) {
- atom_diag_worker{this}.autopartition();
+atom_diag::atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, int n_threads)
+   : h_atomic(h_), fops(fops) {
+ atom_diag_worker{this, n_threads}.autopartition();
  complete_init();
 }
 
@@ -53,6 +55,19 @@ void atom_diag::complete_init() {
  // Calculate the index of the first eigenstate of each block
  first_eigstate_of_block.resize(_total_dim, 0);
  for (int bl = 1; bl < n_blocks(); ++bl) first_eigstate_of_block[bl] = first_eigstate_of_block[bl - 1] + get_block_dim(bl - 1);
+
+ // Sparse versions of the operator matrices, for those with few non-zero elements
+ auto make_sparse = [](std::vector<std::vector<matrix_t>> const& Mvv) {
+  std::vector<std::vector<csr_matrix_t>> R(Mvv.size());
+  for (int i = 0; i < Mvv.size(); ++i) {
+   R[i].resize(Mvv[i].size());
+   for (int j = 0; j < Mvv[i].size(); ++j)
+    if (!Mvv[i][j].is_empty() && (fill_ratio(Mvv[i][j]) <= max_sparse_fill_ratio)) R[i][j] = make_csr_matrix(Mvv[i][j]);
+  }
+  return R;
+ };
+ c_sparse_matrices = make_sparse(c_matrices);
+ cdag_sparse_matrices = make_sparse(cdag_matrices);
 }
 
 // -----------------------------------------------------------------
@@ -184,6 +199,54 @@ std::pair<int, matrix<h_scalar_t>> atom_diag::matrix_element_of_monomial(operato
  return {B, std::move(m)};
 }
 
+// -----------------------------------------------------------------
+
+std::pair<atom_diag, std::vector<int>> atom_diag::truncated(double energy_cutoff) const {
+ atom_diag r;
+ r.h_atomic = h_atomic;
+ r.fops = fops;
+ r.gs_energy = gs_energy;
+
+ // the eigenvalues are in ascending order : keep the first n_kept[B] states of block B
+ std::vector<int> n_kept(n_blocks(), 0), block_map(n_blocks(), -1);
+ for (int B = 0; B < n_blocks(); ++B) {
+  auto const& es = eigensystems[B];
+  int n = 0;
+  while ((n < get_block_dim(B)) && (es.eigenvalues[n] <= energy_cutoff)) ++n;
+  if (n == 0) continue;
+  n_kept[B] = n;
+  block_map[B] = r.eigensystems.size();
+  r.sub_hilbert_spaces.push_back(sub_hilbert_spaces[B]);
+  r.eigensystems.push_back({es.eigenvalues(range(0, n)), es.unitary_matrix(range(), range(0, n))});
+  if (B < quantum_numbers.size()) r.quantum_numbers.push_back(quantum_numbers[B]);
+ }
+
+ // the connections and matrices of the operators, between the kept blocks and states
+ int n_ops = first_dim(creation_connection), n_kept_blocks = r.eigensystems.size();
+ auto truncate_op = [&](matrix<long> const& connection, std::vector<std::vector<matrix_t>> const& Mvv,
+                        matrix<long>& r_connection, std::vector<std::vector<matrix_t>>& r_Mvv) {
+  r_connection.resize(n_ops, n_kept_blocks);
+  r_Mvv.assign(n_ops, std::vector<matrix_t>(n_kept_blocks));
+  for (int op = 0; op < n_ops; ++op)
+   for (int B = 0; B < n_blocks(); ++B) {
+    if (block_map[B] == -1) continue;
+    long Bp = connection(op, B);
+    long b = block_map[B], bp = (Bp == -1 ? -1 : block_map[Bp]);
+    r_connection(op, b) = bp;
+    if (bp != -1) r_Mvv[op][b] = Mvv[op][B](range(0, n_kept[Bp]), range(0, n_kept[B]));
+   }
+ };
+ truncate_op(creation_connection, cdag_matrices, r.creation_connection, r.cdag_matrices);
+ truncate_op(annihilation_connection, c_matrices, r.annihilation_connection, r.c_matrices);
+
+ // the vacuum may have been removed
+ r.vacuum_block_index = block_map[vacuum_block_index];
+ r.vacuum_inner_index = (r.vacuum_block_index == -1 ? -1 : vacuum_inner_index);
+
+ r.complete_init();
+ return {std::move(r), std::move(block_map)};
+}
+
 }
 
 namespace cthyb {
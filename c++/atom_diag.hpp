@@ -20,6 +20,7 @@
  ******************************************************************************/
 #pragma once
 #include "./config.hpp"
+#include "./sparse_matrix.hpp"
 #include <vector>
 #include <map>
 
@@ -33,6 +34,7 @@ using quantum_number_t = double;                                      // qn oper
 // Division of Hilbert Space into sub hilbert spaces, using the quantum numbers.
 class atom_diag {
  friend class atom_diag_worker;
+ friend class atom_diag_cache;
 
  public:
  struct eigensystem_t {
@@ -41,8 +43,9 @@ class atom_diag {
  };
 
  TRIQS_CPP2PY_IGNORE atom_diag() = default;
- atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops);
- atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, std::vector<many_body_op_t> const& qn_vector);
+ atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, int n_threads = 1);
+ atom_diag(many_body_op_t const& h_, fundamental_operator_set const& fops, std::vector<many_body_op_t> const& qn_vector,
+           int n_threads = 1);
 
  /// The Hamiltonian
  many_body_op_t const& get_h_atomic() const { return h_atomic; }
@@ -144,6 +147,21 @@ class atom_diag {
   return cdag_matrices[op_linear_index][block_index];
  }
 
+ /**
+  * Sparse (CSR) version of c_matrix, or nullptr if the matrix is not sparse enough
+  * to make it worthwhile (fill ratio above max_sparse_fill_ratio).
+  */
+ TRIQS_CPP2PY_IGNORE csr_matrix_t const* c_sparse_matrix(int op_linear_index, int block_index) const {
+  auto const& m = c_sparse_matrices[op_linear_index][block_index];
+  return (m.n_rows > 0 ? &m : nullptr);
+ }
+
+ /// Sparse (CSR) version of cdag_matrix, or nullptr (cf c_sparse_matrix)
+ TRIQS_CPP2PY_IGNORE csr_matrix_t const* cdag_sparse_matrix(int op_linear_index, int block_index) const {
+  auto const& m = cdag_sparse_matrices[op_linear_index][block_index];
+  return (m.n_rows > 0 ? &m : nullptr);
+ }
+
  //FIXME
  /**
    * For a symmetry S implemented as a unitary transformation of the C operators
@@ -159,6 +177,13 @@ class atom_diag {
   */
  TRIQS_CPP2PY_IGNORE std::pair<int, matrix_t> matrix_element_of_monomial(operators::monomial_t const& op_vec, int B) const;
 
+ /**
+  * Copy keeping only the eigenstates with an energy (above the ground state) <= energy_cutoff.
+  * Since the eigenvalues are sorted, the first states of each block are kept. Blocks with no state left are removed.
+  * @return : the truncated atom_diag, and for each block B of this, the corresponding block of the result (-1 if removed)
+  */
+ TRIQS_CPP2PY_IGNORE std::pair<atom_diag, std::vector<int>> truncated(double energy_cutoff) const;
+
  private:
  /// ------------------  DATA  -----------------
 
@@ -177,6 +202,8 @@ class atom_diag {
 
  // do not serialize. rebuild by complete_init
  void complete_init();
+ std::vector<std::vector<csr_matrix_t>> c_sparse_matrices;    // CSR version of c_matrices if sparse enough, empty otherwise
+ std::vector<std::vector<csr_matrix_t>> cdag_sparse_matrices; // idem for c dagger operators
  std::vector<int> first_eigstate_of_block; // Index of the first eigenstate of each block
  int _total_dim;                           // total_dimension of the Hilbert_space
 
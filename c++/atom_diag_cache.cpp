@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./atom_diag_cache.hpp"
+#include <triqs/h5.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+namespace cthyb {
+
+std::string atom_diag_cache::make_key(many_body_op_t const& h, fundamental_operator_set const& fops,
+                                      std::string const& partition_method, std::vector<many_body_op_t> const& qn_vector) {
+ std::ostringstream key;
+ key << std::setprecision(17) << "h " << h << "\nfops";
+ for (auto const& o : fops) key << " " << o.linear_index << ":" << many_body_op_t::make_canonical(true, o.index);
+ key << "\npartition_method " << partition_method;
+ if (partition_method == "quantum_numbers")
+  for (auto const& qn : qn_vector) key << "\nquantum_number " << qn;
+ return key.str();
+}
+
+//-----------------------------
+
+std::string atom_diag_cache::file_name(std::string const& key) const {
+ uint64_t hash = 14695981039346656037ull; // FNV-1a
+ for (unsigned char c : key) hash = (hash ^ c) * 1099511628211ull;
+ std::ostringstream name;
+ name << dir << "/atom_diag_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".h5";
+ return name.str();
+}
+
+//-----------------------------
+
+bool atom_diag_cache::load(std::string const& key, many_body_op_t const& h, atom_diag& x) const {
+ auto name = file_name(key);
+ if (!std::ifstream(name).good()) return false;
+ try {
+  triqs::h5::file f(name.c_str(), H5F_ACC_RDONLY);
+  std::string stored_key;
+  h5_read(f, "key", stored_key);
+  if (stored_key != key) return false;
+  atom_diag r;
+  h5_read(f, "atom_diag", r);
+  // not in the h5 format of atom_diag
+  r.h_atomic = h;
+  auto qn = f.open_group("quantum_numbers");
+  r.quantum_numbers.resize(qn.get_all_dataset_names().size());
+  for (int b = 0; b < r.quantum_numbers.size(); ++b) h5_read(qn, std::to_string(b), r.quantum_numbers[b]);
+  x = std::move(r);
+  return true;
+ } catch (std::exception const&) { // e.g. a file being written by another process
+  return false;
+ }
+}
+
+//-----------------------------
+
+void atom_diag_cache::store(std::string const& key, atom_diag const& x) const {
+ auto name = file_name(key);
+ // The file is written under a name unique to this process, then renamed, so that concurrent writers of the same
+ // entry (e.g. several jobs sharing the cache directory) never write into the same file.
+ char host[256] = "";
+ gethostname(host, sizeof(host) - 1);
+ auto tmp_name = name + "." + host + "." + std::to_string(getpid()) + ".tmp";
+ {
+  triqs::h5::file f(tmp_name.c_str(), H5F_ACC_TRUNC);
+  h5_write(f, "key", key);
+  h5_write(f, "atom_diag", x);
+  auto qn = f.create_group("quantum_numbers");
+  for (int b = 0; b < x.quantum_numbers.size(); ++b) h5_write(qn, std::to_string(b), x.quantum_numbers[b]);
+ }
+ if (std::rename(tmp_name.c_str(), name.c_str()) != 0) {
+  std::remove(tmp_name.c_str());
+  TRIQS_RUNTIME_ERROR << "Cannot write the atom_diag cache file " << name;
+ }
+}
+}
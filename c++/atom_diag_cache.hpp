@@ -0,0 +1,62 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./atom_diag.hpp"
+#include <string>
+
+namespace cthyb {
+
+/********************************************
+ A cache of diagonalizations on disk.
+
+ The diagonalization of a key is stored in dir/atom_diag_<hash>.h5, with
+ the 64-bit FNV-1a hash of the key in hexadecimal. The key itself is
+ stored in the file too and compared when loading, so a hash collision
+ is a miss.
+ ********************************************/
+class atom_diag_cache {
+
+ public:
+ /// The cache in the directory dir, which must exist
+ atom_diag_cache(std::string dir) : dir(std::move(dir)) {}
+
+ /**
+  * The key of a diagonalization: the Hamiltonian (all digits of the coefficients), the fundamental operators,
+  * the partition method and the quantum numbers if it is "quantum_numbers"
+  */
+ static std::string make_key(many_body_op_t const& h, fundamental_operator_set const& fops, std::string const& partition_method,
+                             std::vector<many_body_op_t> const& qn_vector);
+
+ /**
+  * Load the diagonalization of key into x.
+  * h is the Hamiltonian of the key, which is not stored in the file.
+  * @return : false if it is not in the cache, or if its file cannot be read
+  */
+ bool load(std::string const& key, many_body_op_t const& h, atom_diag& x) const;
+
+ /// Store x as the diagonalization of key. The file is written under a temporary name first.
+ void store(std::string const& key, atom_diag const& x) const;
+
+ private:
+ std::string dir;
+ std::string file_name(std::string const& key) const;
+};
+}
@@ -19,11 +19,13 @@
  *
  ******************************************************************************/
 #include "./atom_diag_worker.hpp"
+#include "./thread_pool.hpp"
 #include <triqs/arrays/linalg/eigenelements.hpp>
 #include <triqs/hilbert_space/space_partition.hpp>
 #include <sstream>
 #include <bitset>
 #include <algorithm>
+#include <numeric>
 using namespace triqs::arrays;
 using namespace triqs::hilbert_space;
 using std::string;
@@ -111,28 +113,62 @@ struct lt_dbl {
 
 //-----------------------------
 
+// A quantum number as its diagonal elements <f|Q|f> in the Fock states f, evaluated directly on the bits of f.
+// Only the monomials with the same creation and annihilation operators contribute: being normal ordered, they are
+// products of occupation numbers up to a sign, which is the same for all the f where they are not 0.
+struct diagonal_quantum_number {
+
+ struct term {
+  fock_state_t mask; // the occupation numbers of the product
+  h_scalar_t coef;   // coefficient of the monomial times its sign
+ };
+ std::vector<term> terms;
+
+ diagonal_quantum_number(many_body_op_t const& op, fundamental_operator_set const& fops) {
+  for (auto const& x : op) {
+   fock_state_t created = 0, annihilated = 0;
+   for (auto const& o : x.monomial) (o.dagger ? created : annihilated) |= fock_state_t(1) << fops[o.indices];
+   if (created != annihilated) continue;
+   // the sign, from the action of the operators (right to left) on the state with only the mask occupied
+   fock_state_t f = created;
+   int sign = 1;
+   for (int i = int(x.monomial.size()) - 1; i >= 0; --i) {
+    fock_state_t bit = fock_state_t(1) << fops[x.monomial[i].indices];
+    if (std::bitset<64>(f & (bit - 1)).count() % 2) sign = -sign;
+    f ^= bit;
+   }
+   terms.push_back({created, h_scalar_t(sign) * x.coef});
+  }
+ }
+
+ quantum_number_t operator()(fock_state_t f) const {
+  h_scalar_t y = 0;
+  for (auto const& t : terms)
+   if ((f & t.mask) == t.mask) y += t.coef;
+  if (std::abs(imag(y)) > 1.e-10) TRIQS_RUNTIME_ERROR << " qn is complex !!";
+  return real(y);
+ }
+};
+
+//-----------------------------
+
 void atom_diag_worker::partition_with_qn(std::vector<many_body_op_t> const& qn_vector) {
 
  fundamental_operator_set const& fops = hdiag->get_fops();
- many_body_op_t const& h_ = hdiag->get_h_atomic();
- 
+
  hilbert_space full_hs(fops);
 
  // hilbert spaces and quantum numbers
  std::map<std::vector<double>, int, lt_dbl> map_qn_n;
 
- // The QN as operators : a vector of imperative operators for the quantum numbers
- std::vector<imperative_operator<hilbert_space, h_scalar_t>> qsize;
+ // The QN, evaluated on the Fock states without building any state
+ std::vector<diagonal_quantum_number> qsize;
  for (auto& qn : qn_vector) qsize.emplace_back(qn, fops);
 
  // Helper function to get quantum numbers
- auto get_quantum_numbers = [&qsize](state<hilbert_space, h_scalar_t, false> const& s) {
+ auto get_quantum_numbers = [&qsize](fock_state_t f) {
   std::vector<quantum_number_t> qn;
-  for (auto const& op : qsize) {
-   auto y = dot_product(s, op(s));
-   if (std::abs(imag(y)) > 1.e-10) TRIQS_RUNTIME_ERROR << " qn is complex !!";
-   qn.push_back(real(y));
-  }
+  for (auto const& q : qsize) qn.push_back(q(f));
   return qn;
  };
 
@@ -140,17 +176,14 @@ void atom_diag_worker::partition_with_qn(std::vector<many_body_op_t> const& qn_v
    The first part consists in dividing the full Hilbert space
    into smaller subspaces using the quantum numbers
  */
+ std::vector<int> block_of_state(full_hs.size()); // block of each state of full_hs
  for (int r = 0; r < full_hs.size(); ++r) {
 
   // fock_state corresponding to r
   fock_state_t fs = full_hs.get_fock_state(r);
 
-  // the state we'll act on
-  state<hilbert_space, h_scalar_t, false> s(full_hs);
-  s(r) = 1.0;
-
   // create the vector with the quantum numbers
-  std::vector<quantum_number_t> qn = get_quantum_numbers(s);
+  std::vector<quantum_number_t> qn = get_quantum_numbers(fs);
 
   // if first time we meet these quantum numbers create partial Hilbert space
   if (map_qn_n.count(qn) == 0) {
@@ -161,7 +194,8 @@ void atom_diag_worker::partition_with_qn(std::vector<many_body_op_t> const& qn_v
   }
 
   // add fock state to partial Hilbert space
-  hdiag->sub_hilbert_spaces[map_qn_n[qn]].add_fock_state(fs);
+  block_of_state[r] = map_qn_n[qn];
+  hdiag->sub_hilbert_spaces[block_of_state[r]].add_fock_state(fs);
  }
 
  // ----  now make the creation map -----
@@ -177,52 +211,29 @@ void atom_diag_worker::partition_with_qn(std::vector<many_body_op_t> const& qn_v
 
  for (auto const& x : fops) {
 
-  // get the operators and their index
+  // c_dag and c change only the bit n of the Fock states: c_dag|f> (c|f>) is f with the bit n set (unset) up to a sign,
+  // or 0 if it is already set (unset)
   int n = x.linear_index;
-  auto create = many_body_op_t::make_canonical(true, x.index);
-  auto destroy = many_body_op_t::make_canonical(false, x.index);
-
-  // construct their imperative counterpart
-  imperative_operator<hilbert_space, h_scalar_t> op_c_dag(create, fops), op_c(destroy, fops);
-
-  // to avoid declaring every time in the loop below
-  std::vector<quantum_number_t> qn_before, qn_after;
+  fock_state_t bit = fock_state_t(1) << n;
+
+  // insert in the map checking whether it was already there
+  auto connect = [n](std::vector<int>& map, matrix<long>& connection, int origin, int target, const char* what) {
+   if (map[origin] == -1)
+    map[origin] = target;
+   else if (map[origin] != target)
+    TRIQS_RUNTIME_ERROR << "Internal Error, AtomDiag, " << what;
+   connection(n, origin) = target;
+  };
 
-  // now act on the state with the c, c_dag to see how quantum numbers change
   for (int r = 0; r < full_hs.size(); ++r) {
-
-   // the state we'll act on and its quantum numbers
-   state<hilbert_space, h_scalar_t, false> s(full_hs);
-   s(r) = 1.0;
-   qn_before = get_quantum_numbers(s);
-
-   // apply creation on state to figure quantum numbers
-   qn_after = get_quantum_numbers(op_c_dag(s));
-
-   // insert in creation map checking whether it was already there
-   if (!triqs::utility::is_zero(dot_product(op_c_dag(s), op_c_dag(s)))) {
-    auto origin = hdiag->sub_hilbert_spaces[map_qn_n[qn_before]].get_index();
-    auto target = hdiag->sub_hilbert_spaces[map_qn_n[qn_after]].get_index();
-    if (creation_map[n][origin] == -1)
-     creation_map[n][origin] = target;
-    else if (creation_map[n][origin] != target)
-     TRIQS_RUNTIME_ERROR << "Internal Error, AtomDiag, creation";
-    hdiag->creation_connection(n,map_qn_n[qn_before]) = map_qn_n[qn_after];
-   }
-
-   // apply annihilation on state to figure quantum numbers
-   qn_after = get_quantum_numbers(op_c(s));
-
-   // insert in annihilation map checking whether it was already there
-   if (!triqs::utility::is_zero(dot_product(op_c(s), op_c(s)))) {
-    auto origin = hdiag->sub_hilbert_spaces[map_qn_n[qn_before]].get_index();
-    auto target = hdiag->sub_hilbert_spaces[map_qn_n[qn_after]].get_index();
-    if (annihilation_map[n][origin] == -1)
-     annihilation_map[n][origin] = target;
-    else if (annihilation_map[n][origin] != target)
-     TRIQS_RUNTIME_ERROR << "Internal Error, AtomDiag, annihilation";
-    hdiag->annihilation_connection(n, map_qn_n[qn_before]) = map_qn_n[qn_after];
-   }
+   fock_state_t fs = full_hs.get_fock_state(r);
+   int origin = block_of_state[r];
+   if (!(fs & bit))
+    connect(creation_map[n], hdiag->creation_connection, origin,
+            block_of_state[full_hs.get_state_index(fs | bit)], "creation");
+   else
+    connect(annihilation_map[n], hdiag->annihilation_connection, origin,
+            block_of_state[full_hs.get_state_index(fs & ~bit)], "annihilation");
   }
  }
  complete();
@@ -267,12 +278,19 @@ void atom_diag_worker::complete() {
  hdiag->eigensystems.resize(n_subspaces);
  hdiag->gs_energy = std::numeric_limits<double>::infinity();
 
- // Prepare the eigensystem in a temporary map to sort them by energy !
- std::map<std::pair<double, int>, atom_diag::eigensystem_t> eign_map;
- double energy_split = 1.e-10; // to split the eigenvalues which are numerically very close 
- for (int spn = 0; spn < n_subspaces; ++spn) {
+ // The blocks are diagonalized in parallel (no thread for a single block), the largest first for the load balance
+ thread_pool pool(n_subspaces > 1 ? std::max(1, n_threads) : 1);
+ std::vector<int> largest_first(n_subspaces);
+ std::iota(largest_first.begin(), largest_first.end(), 0);
+ std::stable_sort(largest_first.begin(), largest_first.end(), [this](int a, int b) {
+  return hdiag->sub_hilbert_spaces[a].size() > hdiag->sub_hilbert_spaces[b].size();
+ });
+
+ std::vector<atom_diag::eigensystem_t> eigensystems(n_subspaces);
+ pool.run(n_subspaces, [&](int task, int) {
+  int spn = largest_first[task];
   auto const& sp = hdiag->sub_hilbert_spaces[spn];
-  atom_diag::eigensystem_t eigensystem;
+  atom_diag::eigensystem_t& eigensystem = eigensystems[spn];
 
   state<sub_hilbert_space, h_scalar_t, false> i_state(sp);
   matrix_t h_matrix(sp.size(), sp.size());
@@ -287,7 +305,6 @@ void atom_diag_worker::complete() {
   auto eig = linalg::eigenelements(h_matrix);
   eigensystem.eigenvalues = eig.first;
   eigensystem.unitary_matrix = eig.second.transpose(); // Convert from eigenvectors as rows to columns.
-  hdiag->gs_energy = std::min(hdiag->gs_energy, eigensystem.eigenvalues[0]);
 
 //FIXME
  /* eigensystem.eigenstates.reserve(sp.size());
@@ -296,22 +313,33 @@ void atom_diag_worker::complete() {
    eigensystem.eigenstates.back().amplitudes() = h_matrix(e, range());
   }
 */
-  eign_map.insert({{eigensystem.eigenvalues(0) + energy_split * spn, spn}, eigensystem});
+ });
+
+ // Prepare the eigensystem in a temporary map to sort them by energy !
+ std::map<std::pair<double, int>, atom_diag::eigensystem_t> eign_map;
+ double energy_split = 1.e-10; // to split the eigenvalues which are numerically very close 
+ for (int spn = 0; spn < n_subspaces; ++spn) {
+  auto& eigensystem = eigensystems[spn];
+  hdiag->gs_energy = std::min(hdiag->gs_energy, eigensystem.eigenvalues[0]);
+  eign_map.insert({{eigensystem.eigenvalues(0) + energy_split * spn, spn}, std::move(eigensystem)});
  }
 
  // Reorder the block along their minimal energy
  {
   auto tmp = hdiag->sub_hilbert_spaces;
+  auto tmp_qn = hdiag->quantum_numbers; // empty for the autopartition
   std::map<int, int> remap;
   int i = 0;
   for (auto const& x : eign_map) { // in order of min energy !
    hdiag->eigensystems[i] = x.second;
    tmp[i] = hdiag->sub_hilbert_spaces[x.first.second];
    tmp[i].set_index(i);
+   if (!tmp_qn.empty()) tmp_qn[i] = hdiag->quantum_numbers[x.first.second];
    remap[x.first.second] = i;
    ++i;
   }
   std::swap(tmp, hdiag->sub_hilbert_spaces);
+  std::swap(tmp_qn, hdiag->quantum_numbers);
   auto remap_connection = [&](matrix<long>& connection) {
    auto c2 = connection;
    for (int n = 0; n < first_dim(connection); ++n)
@@ -329,34 +357,40 @@ void atom_diag_worker::complete() {
  // Shift the ground state energy of the local Hamiltonian to zero.
  for (auto& eigensystem : hdiag->eigensystems) eigensystem.eigenvalues() -= hdiag->get_gs_energy();
 
+ // The imperative c, c dagger operators, by linear index
+ // fops is iterated in the order of the linear index n = 0,1,2,3, ... (guaranteed by the fundamental_operator_set class)
+ std::vector<imperative_operator<hilbert_space, h_scalar_t>> op_c, op_c_dag;
  for (auto const& x : fops) {
-  // get the operators and their index
-  int n = x.linear_index;
-  // n is guaranteed to be 0,1,2,3,  by the fundamental_operator_set class ... but it is very weird...
-  // otherwise the push_back below is false.
-  auto create = many_body_op_t::make_canonical(true, x.index);
-  auto destroy = many_body_op_t::make_canonical(false, x.index);
-  // construct their imperative counterpart
-  imperative_operator<hilbert_space, h_scalar_t> op_c_dag(create, fops), op_c(destroy, fops);
+  op_c.emplace_back(many_body_op_t::make_canonical(false, x.index), fops);
+  op_c_dag.emplace_back(many_body_op_t::make_canonical(true, x.index), fops);
+ }
 
-  // Compute the matrices of c, c dagger in the diagonalization base of H_loc
-  // first a lambda, since it is almost the same code for c and cdag
-  auto make_c_mat = [&](int n, matrix<long> const& connection, imperative_operator<hilbert_space, h_scalar_t> c_op) {
-   std::vector<matrix_t> cmat(second_dim(connection));
+ // Compute the matrices of c, c dagger in the diagonalization base of H_loc, for all operators n and initial blocks B.
+ // They are computed in parallel, the largest first.
+ struct c_matrix_task {
+  bool creation; // c dagger or c
+  int n, B, Bp;
+  long cost; // ~ number of elements
+ };
+ std::vector<c_matrix_task> tasks;
+ for (bool creation : {false, true}) {
+  auto const& connection = (creation ? hdiag->creation_connection : hdiag->annihilation_connection);
+  for (int n = 0; n < first_dim(connection); ++n)
    for (int B = 0; B < second_dim(connection); ++B) {
-    auto Bp = connection(n, B);
-    if (Bp == -1) continue;
-    auto M = make_op_matrix(c_op, B, Bp);
-    cmat[B] = dagger(hdiag->eigensystems[Bp].unitary_matrix) * M * hdiag->eigensystems[B].unitary_matrix;
+    int Bp = connection(n, B);
+    if (Bp != -1) tasks.push_back({creation, n, B, Bp, long(hdiag->get_block_dim(B)) * hdiag->get_block_dim(Bp)});
    }
-   return cmat;
-  };
-
-  // now execute code...
-  hdiag->c_matrices.push_back(make_c_mat(n, hdiag->annihilation_connection, op_c));
-  hdiag->cdag_matrices.push_back(make_c_mat(n, hdiag->creation_connection, op_c_dag));
-
- } // end of loop on operators
+ }
+ std::stable_sort(tasks.begin(), tasks.end(), [](c_matrix_task const& a, c_matrix_task const& b) { return a.cost > b.cost; });
+
+ hdiag->c_matrices.assign(fops.size(), std::vector<matrix_t>(n_subspaces));
+ hdiag->cdag_matrices.assign(fops.size(), std::vector<matrix_t>(n_subspaces));
+ pool.run(tasks.size(), [&](int t, int) {
+  auto const& task = tasks[t];
+  auto M = make_op_matrix((task.creation ? op_c_dag : op_c)[task.n], task.B, task.Bp);
+  (task.creation ? hdiag->cdag_matrices : hdiag->c_matrices)[task.n][task.B] =
+      dagger(hdiag->eigensystems[task.Bp].unitary_matrix) * M * hdiag->eigensystems[task.B].unitary_matrix;
+ });
 
  hdiag->vacuum_block_index = -1;
  // get the position of the bare vacuum
@@ -26,13 +26,15 @@ namespace cthyb {
 // Division of Hilbert Space into sub hilbert spaces, using either autopartitioning or quantum numbers.
 struct atom_diag_worker {
 
- atom_diag_worker(atom_diag* hdiag, int n_min = 0, int n_max = 10000) : hdiag(hdiag), n_min(n_min), n_max(n_max) {}
+ atom_diag_worker(atom_diag* hdiag, int n_threads = 1, int n_min = 0, int n_max = 10000)
+    : hdiag(hdiag), n_threads(n_threads), n_min(n_min), n_max(n_max) {}
 
  void autopartition();
  void partition_with_qn(std::vector<many_body_op_t> const& qn_vector);
 
  private:
  atom_diag* hdiag;
+ int n_threads; // number of threads diagonalizing the blocks
  int n_min, n_max;
  
  // Create matrix of an operator acting from one subspace to another (returns matrix + number of its nonzero elements)
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./config.hpp"
+#include <limits>
+
+namespace cthyb {
+
+/********************************************
+ Error of a Monte Carlo average from batch means.
+
+ The observable is given as the cumulated sums of its components and of
+ the weight z (the average is sum / z). At each add_batch, the average
+ over the measurements since the previous call is one batch mean x_b, of
+ weight w_b the increase of z during the batch. The batches of all nodes
+ are combined in the error of the weighted mean m = sum_b w_b x_b / sum_b w_b :
+   error^2 = n / (n-1) * sum_b w_b^2 (x_b - m)^2 / (sum_b w_b)^2
+ which is the usual error of the batch means when all batches have the same weight.
+ ********************************************/
+class batch_error_estimator {
+
+ arrays::vector<double> previous, wx, w2x, w2x2; // cumulated values at the last batch, sums of w x, w^2 x, w^2 x^2
+ double z_previous = 0, w = 0, w2 = 0;           // cumulated weight at the last batch, sums of w and w^2
+ long n_batches = 0;
+
+ public:
+ /// For an observable with size components
+ batch_error_estimator(long size) : previous(size), wx(size), w2x(size), w2x2(size) {
+  previous() = 0;
+  wx() = 0;
+  w2x() = 0;
+  w2x2() = 0;
+ }
+
+ /// Minimal number of batches (over all nodes) for an error estimate
+ static constexpr long min_batches = 16;
+
+ /// A new batch, from the cumulated sums of the components of the observable and of the weight
+ void add_batch(arrays::vector<double> const& values, double z) {
+  double dz = z - z_previous;
+  if (dz == 0) return; // no measurement since the last batch
+  for (int i = 0; i < values.size(); ++i) {
+   double x = (values(i) - previous(i)) / dz;
+   wx(i) += dz * x;
+   w2x(i) += dz * dz * x;
+   w2x2(i) += dz * dz * x * x;
+  }
+  w += dz;
+  w2 += dz * dz;
+  previous = values;
+  z_previous = z;
+  ++n_batches;
+ }
+
+ /// The largest error over the components, or +inf if there are fewer than min_batches batches over all nodes
+ double max_error(triqs::mpi::communicator const& c) const {
+  long n = mpi_all_reduce(n_batches, c);
+  if (n < min_batches) return std::numeric_limits<double>::infinity();
+  arrays::vector<double> s = mpi_all_reduce(wx, c), s2 = mpi_all_reduce(w2x, c), s22 = mpi_all_reduce(w2x2, c);
+  double sw = mpi_all_reduce(w, c), sw2 = mpi_all_reduce(w2, c);
+  double r = 0;
+  for (int i = 0; i < s.size(); ++i) {
+   double m = s(i) / sw;
+   r = std::max(r, (s22(i) - 2 * m * s2(i) + m * m * sw2) / (sw * sw) * n / (n - 1));
+  }
+  return std::sqrt(r);
+ }
+};
+}
@@ -0,0 +1,104 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cthyb {
+
+/********************************************
+ Binning analysis of a time series, in O(log n) memory.
+
+ The series is accumulated at all levels l at once: level l sees the
+ means of 2^l consecutive values. The variance of the bin means gives the
+ error of the mean and the integrated autocorrelation time, taken at the
+ last level with enough bins for the variance to be reliable.
+ ********************************************/
+class log_binning {
+
+ struct level_t {
+  long n = 0;             // number of (complete) bins
+  double sum = 0, sum2 = 0; // sums of the bin means and of their squares
+  double half = 0;        // first half of the bin of the next level being filled
+  bool has_half = false;
+ };
+ std::vector<level_t> levels;
+
+ // variance of the bin means at level l
+ double variance(int l) const {
+  auto const& L = levels[l];
+  double m = L.sum / L.n;
+  return std::max(0.0, L.sum2 / L.n - m * m);
+ }
+
+ public:
+ /// Minimal number of bins of a level used for the estimates
+ static constexpr long min_bins = 64;
+
+ /// Add a value to the series
+ log_binning& operator<<(double x) {
+  for (int l = 0;; ++l) {
+   if (l == int(levels.size())) levels.emplace_back();
+   auto& L = levels[l];
+   L.n++;
+   L.sum += x;
+   L.sum2 += x * x;
+   if (!L.has_half) {
+    L.half = x;
+    L.has_half = true;
+    return *this;
+   }
+   x = (L.half + x) / 2; // the bin of the next level is complete
+   L.has_half = false;
+  }
+ }
+
+ /// Number of values in the series
+ long size() const { return (levels.empty() ? 0 : levels[0].n); }
+
+ /// Mean of the series
+ double mean() const { return (levels.empty() ? 0 : levels[0].sum / levels[0].n); }
+
+ /// Level of the estimates: the last one with at least min_bins bins (0 if the series is too short)
+ int plateau_level() const {
+  int l = 0;
+  while ((l + 1 < int(levels.size())) && (levels[l + 1].n >= min_bins)) ++l;
+  return l;
+ }
+
+ /// Statistical error of the mean
+ double error() const {
+  if (size() < 2) return 0;
+  int l = plateau_level();
+  return std::sqrt(variance(l) / (levels[l].n - 1));
+ }
+
+ /// Integrated autocorrelation time, in units of the spacing of the series (1/2 for uncorrelated values)
+ double autocorrelation_time() const {
+  if (size() < 2) return 0.5;
+  double v0 = variance(0);
+  if (v0 == 0) return 0.5; // constant series
+  int l = plateau_level();
+  return std::max(0.5, 0.5 * std::ldexp(variance(l), l) / v0);
+ }
+};
+}
@@ -50,6 +50,33 @@ struct op_desc {
  }
 };
 
+// The operators of a configuration in a flat form, to save it and to start a Monte Carlo from it
+struct configuration_data_t {
+ double beta = 1;
+ std::vector<double> tau;
+ std::vector<int> block_index, inner_index, dagger;
+
+ int size() const { return tau.size(); }
+
+ friend void h5_write(triqs::h5::group g, std::string const& name, configuration_data_t const& c) {
+  auto gr = g.create_group(name);
+  h5_write(gr, "beta", c.beta);
+  h5_write(gr, "tau", c.tau);
+  h5_write(gr, "block_index", c.block_index);
+  h5_write(gr, "inner_index", c.inner_index);
+  h5_write(gr, "dagger", c.dagger);
+ }
+
+ friend void h5_read(triqs::h5::group g, std::string const& name, configuration_data_t& c) {
+  auto gr = g.open_group(name);
+  h5_read(gr, "beta", c.beta);
+  h5_read(gr, "tau", c.tau);
+  h5_read(gr, "block_index", c.block_index);
+  h5_read(gr, "inner_index", c.inner_index);
+  h5_read(gr, "dagger", c.dagger);
+ }
+};
+
 // The configuration of the Monte Carlo
 struct configuration {
 
@@ -94,6 +121,19 @@ struct configuration {
   }
  }
 
+ // The operators in flat form
+ configuration_data_t get_data() const {
+  configuration_data_t r;
+  r.beta = beta_;
+  for (auto const& op : oplist) {
+   r.tau.push_back(double(op.first));
+   r.block_index.push_back(op.second.block_index);
+   r.inner_index.push_back(op.second.inner_index);
+   r.dagger.push_back(op.second.dagger);
+  }
+  return r;
+ }
+
  long get_id() const { return id; } // Get the id of the current configuration
  void finalize() {
   id++;
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <triqs/utility/time_pt.hpp>
+
+namespace cthyb {
+
+using triqs::utility::time_pt;
+
+/********************************************
+ Positions of the operators in the determinants.
+
+ A det stores its operators in decreasing time order : the times of the
+ c^dagger (det.get_x(i).first) and of the c (det.get_y(i).first) are
+ sorted arrays, accessed in O(1), so that positions are found by bisection.
+ ********************************************/
+
+/// The first position i such that pred(tau_i) is true, or det.size() if there is none, where tau_i are the times
+/// of the c^dagger (dagger = true) or of the c of det. pred must be false, then true along the det.
+template <typename Det, typename Pred> int det_partition_point(Det const& det, bool dagger, Pred const& pred) {
+ int lo = 0, hi = det.size();
+ while (lo < hi) {
+  int mid = lo + (hi - lo) / 2;
+  if (pred(dagger ? det.get_x(mid).first : det.get_y(mid).first))
+   hi = mid;
+  else
+   lo = mid + 1;
+ }
+ return lo;
+}
+
+/// The position in det of an operator at time tau : the number of operators at larger times
+template <typename Det> int det_position(Det const& det, bool dagger, time_pt const& tau) {
+ return det_partition_point(det, dagger, [&tau](time_pt const& t) { return t < tau; });
+}
+}
@@ -87,11 +87,11 @@ void impurity_trace::check_cache_integrity_one_node(node n, bool print) {
  if (print) std::cout << " ... checking cache integrity for node " << n->key << std::endl;
 
  // debug check : redo the linear calculation
- auto& ca = n->cache;
+ auto ca = n->cache.slab;
  for (int b = 0; b < n_blocks; ++b) {
   auto check = check_one_block_table_linear(n, b, false);
-  if (ca.block_table[b] != check) {
-   std::cout << " Inconsistent block table for block " << b << " : cache =  " << ca.block_table[b] << " while it should be  "
+  if (ca->block_table[b] != check) {
+   std::cout << " Inconsistent block table for block " << b << " : cache =  " << ca->block_table[b] << " while it should be  "
              << check << std::endl;
    check_one_block_table_linear(n, b, true);
    TRIQS_RUNTIME_ERROR << " FATAL ";
@@ -34,38 +34,42 @@
 
 double double_max = std::numeric_limits<double>::max(); // easier to read
 
-template <typename T>
-// require( is_real_or_complex<T>) FIXME?
-double frobenius_norm2(triqs::arrays::matrix<T> const& a) {
- double r = 0;
- for (int i = 0; i < first_dim(a); ++i)
-  for (int j = 0; j < second_dim(a); ++j) {
-   auto ab = std::abs(a(i, j));
-   r += ab * ab;
-  }
- return std::sqrt(r);
-}
-
-
-
 // -----------------------------------------------
 
 namespace cthyb {
 
 // -------- Constructor --------
-impurity_trace::impurity_trace(configuration& c, atom_diag const& h_diag_, solve_parameters_t const& p, histo_map_t * hist_map)
+impurity_trace::impurity_trace(configuration& c, atom_diag const& h_diag_, solve_parameters_t const& p,
+                               histo_map_t* hist_map, sliding_window const* window)
    : config(&c),
      h_diag(&h_diag_),
      histo(p.performance_analysis ? new histograms_t(h_diag_.n_blocks(), *hist_map) : nullptr),
      atomic_z(partition_function(*h_diag, config->beta())),
      atomic_norm(0),
      atomic_rho(n_blocks),
-     density_matrix(n_blocks) {
+     density_matrix(n_blocks),
+     committed_density_matrix(n_blocks),
+     cache_pool(h_diag_),
+     block_threads(std::max(1, p.n_trace_threads)),
+     workspaces(block_threads.n_workers()) {
+
+ // the product kernels, chosen from the dimension of the block where the time evolution acts
+ for (int bl = 0; bl < n_blocks; ++bl) block_kernels.push_back(kernels::scaled_gemm_for_dim(get_block_dim(bl)));
 
  use_norm_as_weight = p.use_norm_as_weight;
  measure_density_matrix = p.measure_density_matrix;
+
+ if ((p.trace_method != "rb_tree") && (p.trace_method != "window"))
+  TRIQS_RUNTIME_ERROR << "trace_method must be \"rb_tree\" or \"window\", not \"" << p.trace_method << "\"";
+ window_mode = (p.trace_method == "window");
+ this->window = window;
+ if (window_mode && ((window == nullptr) || window->is_full()))
+  TRIQS_RUNTIME_ERROR << "trace_method = \"window\" needs a time window of the moves : set n_move_windows > 1";
+ if (window_mode && use_norm_as_weight)
+  TRIQS_RUNTIME_ERROR << "trace_method = \"window\" does not compute the density matrix : set use_norm_as_weight = False";
  // init density_matrix block + bool
  for (int bl = 0; bl < n_blocks; ++bl) density_matrix[bl] = bool_and_matrix{false, matrix_t(get_block_dim(bl), get_block_dim(bl))};
+ committed_density_matrix = density_matrix;
 
  // prepare atomic_rho and atomic_norm
  if (use_norm_as_weight) {
@@ -104,7 +108,7 @@ impurity_trace::impurity_trace(configuration& c, atom_diag const& h_diag_, solve
 int impurity_trace::compute_block_table(node n, int b) {
 
  if (b < 0) TRIQS_RUNTIME_ERROR << " b < 0";
- if (!n->modified) return n->cache.block_table[b];
+ if (!n->modified) return n->cache.slab->block_table[b];
 
  int b1 = (n->right ? compute_block_table(n->right, b) : b);
  if (b1 < 0) return b1;
@@ -122,7 +126,7 @@ int impurity_trace::compute_block_table(node n, int b) {
 std::pair<int, double> impurity_trace::compute_block_table_and_bound(node n, int b, double lnorm_threshold, bool use_threshold) {
 
  if (b < 0) TRIQS_RUNTIME_ERROR << " b < 0";
- if (!n->modified) return {n->cache.block_table[b], n->cache.matrix_lnorms[b]};
+ if (!n->modified) return {n->cache.slab->block_table[b], n->cache.slab->matrix_lnorms[b]};
 
  double lnorm = 0;
 
@@ -160,67 +164,75 @@ std::pair<int, double> impurity_trace::compute_block_table_and_bound(node n, int
 // -------- Computation of the matrix ------------------------------
 
 // returns {block that b connects to at this node, matrix for this block on node n (if not structurally zero, i.e. if B' != -1)}
-std::pair<int, matrix_t> impurity_trace::compute_matrix(node n, int b) {
-
- if (b == -1) return {-1, {}};
- if (n == nullptr) return {b, {}};
- if (!n->modified && n->cache.matrix_norm_valid[b]) return {n->cache.block_table[b], n->cache.matrices[b]};
- bool updating = (!n->modified && !n->cache.matrix_norm_valid[b]);
+// No allocation : the matrix is either in the cache of the node or in the scratch buffers for this depth.
+impurity_trace::matrix_view_t impurity_trace::compute_matrix(node n, int b, workspace_t& ws, int depth) {
+
+ if (b == -1) return {-1, nullptr, 0, 0};
+ if (n == nullptr) return {b, nullptr, 0, 0};
+ auto slab = n->cache.slab;
+ if (!n->modified && slab->matrix_norm_valid[b]) {
+  int bp = slab->block_table[b];
+  return {bp, slab->matrix(b), get_block_dim(bp), get_block_dim(b)};
+ }
+ bool updating = (!n->modified && !slab->matrix_norm_valid[b]);
 
  double dtau_l = 0, dtau_r = 0;
- auto _ = arrays::range();
 
- auto r = compute_matrix(n->right, b);
- int b1 = r.first; // exit block of right subtree
- if (b1 == -1) return {-1, {}};
+ auto r = compute_matrix(n->right, b, ws, depth + 1);
+ int b1 = r.block; // exit block of right subtree
+ if (b1 == -1) return {-1, nullptr, 0, 0};
 
  int b2 = (n->delete_flag ? b1 : get_op_block_map(n, b1)); // relevant block on current node
- if (b2 == -1) return {-1, {}};
-
- matrix_t M = (!n->delete_flag ? get_op_block_matrix(n, b1) : make_unit_matrix<h_scalar_t>(get_block_dim(b1)));
+ if (b2 == -1) return {-1, nullptr, 0, 0};
 
- if (n->right) { // M <- M * exp * r[b]
+ int dim = get_block_dim(b), dim1 = get_block_dim(b1), dim2 = get_block_dim(b2);
+ h_scalar_t* M = ws.get_scratch(depth, 1, long(dim2) * dim);
+ if (n->right) { // M <- op * exp * r[b]
   dtau_r = double(n->key - tree.min_key(n->right));
-  auto dim = second_dim(M); // same as get_block_dim(b2);
-  for (int i = 0; i < dim; ++i) M(_, i) *= std::exp(-dtau_r * get_block_eigenval(b1, i)); // Create time-evolution matrix e^-H(t'-t)
-  if ((first_dim(r.second) == 1) && (second_dim(r.second) == 1))
-   M *= r.second(0, 0);
+  auto ex = get_evolution(slab->exp_r(b1), slab->exp_dtau_r[b1], dtau_r, b1); // time-evolution matrix e^-H(t'-t)
+  if (n->delete_flag) { // the operator is the identity
+   for (int i = 0; i < dim2; ++i)
+    for (int j = 0; j < dim; ++j) M[i * dim + j] = ex[i] * r(i, j);
+  } else if (auto sp = get_op_block_sparse_matrix(n, b1))
+   kernels::sparse_scaled_gemm(*sp, dim, ex, r.data, M);
   else
-   M = M * r.second; // FIXME could try to optimise lapack call?
+   block_kernels[b1](dim2, dim, dim1, get_op_block_matrix(n, b1).data_start(), ex, r.data, M,
+                     ws.get_scratch(depth, 2, long(dim2) * dim1));
+ } else { // M <- op
+  for (int i = 0; i < dim2; ++i)
+   for (int j = 0; j < dim; ++j)
+    M[i * dim + j] = (n->delete_flag ? h_scalar_t(i == j ? 1 : 0) : get_op_block_matrix(n, b1)(i, j));
  }
 
  int b3 = b2;
  if (n->left) { // M <- l[b] * exp * M
-  auto l = compute_matrix(n->left, b2);
-  b3 = l.first;
-  if (b3 == -1) return {-1, {}};
+  auto l = compute_matrix(n->left, b2, ws, depth + 1);
+  b3 = l.block;
+  if (b3 == -1) return {-1, nullptr, 0, 0};
   dtau_l = double(tree.max_key(n->left) - n->key);
-  auto dim = first_dim(M); // same as get_block_dim(b1);
-  for (int i = 0; i < dim; ++i) M(i, _) *= std::exp(-dtau_l * get_block_eigenval(b2, i));
-  if ((first_dim(l.second) == 1) && (second_dim(l.second) == 1))
-   M *= l.second(0, 0);
-  else
-   M = l.second * M;
+  auto ex = get_evolution(slab->exp_l(b2), slab->exp_dtau_l[b2], dtau_l, b2);
+  int dim_l = get_block_dim(b3);
+  h_scalar_t* M2 = ws.get_scratch(depth, 0, long(dim_l) * dim);
+  block_kernels[b2](dim_l, dim, dim2, l.data, ex, M, M2, ws.get_scratch(depth, 2, long(dim_l) * dim2));
+  M = M2;
  }
 
+ int dim3 = get_block_dim(b3);
  if (updating) {
-  n->cache.matrices[b] = M;
-  n->cache.matrix_norm_valid[b] = true;
+  std::copy(M, M + long(dim3) * dim, slab->matrix(b));
+  slab->matrix_norm_valid[b] = true;
 
   // improve the norm if calculating the full_trace
   if (use_norm_of_matrices_in_cache) { // seems slower
-   auto norm = frobenius_norm(M);
-   if (std::abs(norm -frobenius_norm2(M))>1.e-12)  TRIQS_RUNTIME_ERROR << " FROB PB" << M;
-   //if (norm < frobenius_norm2(M))  TRIQS_RUNTIME_ERROR << " FROB PB";
-   //if (norm < frobenius_norm2(M)) std::cout  <<norm <<" vs "<< frobenius_norm2(M)<<std::endl;// TRIQS_RUNTIME_ERROR << " FROB PB";
-   n->cache.matrix_lnorms[b] = -std::log(norm);
+   auto norm = kernels::frobenius_norm(M, long(dim3) * dim);
+   slab->matrix_lnorms[b] = -std::log(norm);
    if (!isfinite(-std::log(norm))) {
-    n->cache.matrix_lnorms[b] = double_max;
+    slab->matrix_lnorms[b] = double_max;
    }
   }
  }
 
- return {b3, std::move(M)};
+ return {b3, M, dim3, dim};
 }
 
 // ------- Update the cache -----------------------
@@ -239,12 +251,14 @@ void impurity_trace::update_cache_impl(node n) {
  update_cache_impl(n->right);
  n->cache.dtau_r = (n->right ? double(n->key - tree.min_key(n->right)) : 0);
  n->cache.dtau_l = (n->left ? double(tree.max_key(n->left) - n->key) : 0);
+ auto slab = n->cache.slab;
  for (int b = 0; b < n_blocks; ++b) {
   auto r = compute_block_table_and_bound(n, b, double_max, false);
-  n->cache.block_table[b] = r.first;
-  n->cache.matrix_lnorms[b] = r.second;
-  n->cache.matrix_norm_valid[b] = false;
+  slab->block_table[b] = r.first;
+  slab->matrix_lnorms[b] = r.second;
+  slab->matrix_norm_valid[b] = false;
  }
+ cache_pool.layout_matrices(slab); // room for the matrices of the new block table
  // This is not necessary here as all modified nodes are "cleared"
  //  by tree::clear_modified in the try/cancel/confirm set
  // n->modified = false;
@@ -259,6 +273,51 @@ void impurity_trace::update_dtau(node n) {
  n->cache.dtau_l = (n->left ? double(tree.max_key(n->left) - n->key) : 0);
 }
 
+//-------- Compute the contribution of one block to the trace ----------------
+// Also recomputes the density matrix of the block if use_norm_as_weight.
+// Called concurrently for different blocks by the workers of block_threads.
+impurity_trace::block_trace_t impurity_trace::compute_block_trace(int block_index, workspace_t& ws, double dtau_beta,
+                                                                 double dtau_0) {
+
+ double dtau = dtau_beta + dtau_0;
+ auto root = tree.get_root();
+ auto b_mat = compute_matrix(root, block_index, ws); // b_mat = {block that b connects to, view of the matrix for this block}
+ if (b_mat.block == -1) TRIQS_RUNTIME_ERROR << " Internal error : B = -1 after compute matrix : " << block_index;
+
+#ifdef CHECK_AGAINST_LINEAR_COMPUTATION
+ auto b_mat2 = check_one_block_matrix_linear(root, block_index, false);
+ for (int u = 0; u < b_mat.dim1; ++u)
+  for (int v = 0; v < b_mat.dim2; ++v)
+   if (std::abs(b_mat(u, v) - b_mat2(u, v)) > 1.e-10) TRIQS_RUNTIME_ERROR << " Matrix failed against linear computation";
+#endif
+
+ // trace(mat * exp(- H * (beta - tmax)) * exp (- H * tmin)) to handle the piece outside of the first-last operators.
+ block_trace_t r{0, 0, 0};
+ auto dim = get_block_dim(block_index);
+ for (int u = 0; u < dim; ++u) {
+  auto x = b_mat(u, u) * std::exp(-dtau * get_block_eigenval(block_index, u));
+  r.trace += x;
+  r.trace_abs += std::abs(x);
+ }
+
+ if (use_norm_as_weight) { // else we are not allowed to compute this matrix, may make no sense
+  // recompute the density matrix
+  auto& mat = density_matrix[block_index].mat;
+  for (int u = 0; u < dim; ++u) {
+   for (int v = 0; v < dim; ++v) {
+    mat(u, v) = b_mat(u, v) * std::exp(-dtau_beta * get_block_eigenval(block_index, u) - dtau_0 * get_block_eigenval(block_index, v));
+    double xx = std::abs(mat(u, v));
+    r.norm_sq += xx * xx;
+   }
+  }
+  // internal check
+  if (std::abs(r.trace) - 1.0000001 * std::sqrt(r.norm_sq) * dim > 1.e-15)
+   TRIQS_RUNTIME_ERROR << "|trace| > dim * norm" << r.trace << " " << std::sqrt(r.norm_sq) << "  " << r.trace_abs;
+  if (std::abs(r.trace - trace(mat)) > 1.e-15) TRIQS_RUNTIME_ERROR << "Internal error : trace and density mismatch";
+ }
+ return r;
+}
+
 //-------- Compute the full trace ------------------------------------------
 // Returns MC atomic weight and reweighting = trace/(atomic weight)
 std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u_yee) {
@@ -266,7 +325,8 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
  double epsilon = 1.e-15; // Machine precision
  auto log_epsilon0 = -std::log(1.e-15);
  double lnorm_threshold = double_max - 100;
- std::vector<std::pair<double, int>> init_to_sort_lnorm_b, to_sort_lnorm_b; // pairs of lnorm and b to sort in order of bound
+ init_to_sort_lnorm_b.clear();
+ to_sort_lnorm_b.clear();
 
  // simplifies later code
  if (tree_size == 0) {
@@ -276,6 +336,8 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
   } else return {atomic_z, 1};
  }
 
+ if (window_mode && trial_in_window()) return compute_in_window();
+
  auto root = tree.get_root();
  // beta - tmax + tmin ! the tree is in REVERSE order
  double dtau_beta = config->beta() - tree.min_key();
@@ -335,7 +397,7 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
  auto trace_contrib_block = std::vector<std::pair<double, int>>{}; //FIXME complex -- can histos handle this?
 
  int n_bl = to_sort_lnorm_b.size();                // number of blocks
- auto bound_cumul = std::vector<double>(n_bl + 1); // cumulative sum of the bounds
+ bound_cumul.resize(n_bl + 1); // cumulative sum of the bounds
  // The contribution to the trace from block B is bounded: |Tr_B| <= dim(B) * sum_{B} e^{Emin(B)*dtau}
  // Here we calculate the cumulative bound from each contributing (structurally non-zero) block to
  // determine at which block we have exceeded the bound and hence can stop.
@@ -349,6 +411,11 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
  }
 
  // Loop over blocks
+ // The blocks are computed by groups of n_workers in parallel, then summed in order. The stopping and
+ // Yee criteria are checked before each block as in the serial case : the result does not depend on n_workers.
+ int n_workers = block_threads.n_workers();
+ block_traces.resize(n_bl);
+ int n_computed = 0; // number of blocks already computed
  int bl;
  for (bl = 0; bl < n_bl; ++bl) { // sum over all blocks
 
@@ -364,45 +431,27 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
    if (pmax < u_yee) return {0, 1}; // pmax < u, we can reject
   }
 
-  // computes the matrices, recursively along the modified path in the tree
-  auto b_mat = compute_matrix(root, block_index); // b_mat = {block that b connects to, matrix for this block}
-  if (b_mat.first == -1) TRIQS_RUNTIME_ERROR << " Internal error : B = -1 after compute matrix : " << block_index;
-
-#ifdef CHECK_AGAINST_LINEAR_COMPUTATION
-  auto b_mat2 = check_one_block_matrix_linear(root, block_index, false);
-  if (max_element(abs(b_mat.second - b_mat2)) > 1.e-10) TRIQS_RUNTIME_ERROR << " Matrix failed against linear computation";
-#endif
-
-  // trace(mat * exp(- H * (beta - tmax)) * exp (- H * tmin)) to handle the piece outside of the first-last operators.
-  h_scalar_t trace_partial = 0;
-  auto dim = get_block_dim(block_index);
-  for (int u = 0; u < dim; ++u) {
-   auto x = b_mat.second(u, u) * std::exp(-dtau * get_block_eigenval(block_index, u));
-   trace_partial += x;
-   trace_abs += std::abs(x);
+  // computes the matrices, recursively along the modified path in the tree, for the next group of blocks
+  if (bl == n_computed) {
+   int n_group = std::min(n_workers, n_bl - bl);
+   if (n_group == 1)
+    block_traces[bl] = compute_block_trace(block_index, workspaces[0], dtau_beta, dtau_0);
+   else
+    block_threads.run(n_group, [&](int t, int w) {
+     block_traces[bl + t] = compute_block_trace(to_sort_lnorm_b[bl + t].second, workspaces[w], dtau_beta, dtau_0);
+    });
+   n_computed = bl + n_group;
   }
 
-  if (use_norm_as_weight) { // else we are not allowed to compute this matrix, may make no sense
-   // recompute the density matrix
+  auto const& trace_partial = block_traces[bl].trace;
+  trace_abs += block_traces[bl].trace_abs;
+  if (use_norm_as_weight) {
    density_matrix[block_index].is_valid = true;
-   double norm_trace_sq_partial = 0;
-   auto& mat = density_matrix[block_index].mat;
-   for (int u = 0; u < dim; ++u) {
-    for (int v = 0; v < dim; ++v) {
-     mat(u, v) = b_mat.second(u, v) *
-                 std::exp(-dtau_beta * get_block_eigenval(block_index, u) - dtau_0 * get_block_eigenval(block_index, v));
-     double xx = std::abs(mat(u, v));
-     norm_trace_sq_partial += xx * xx;
-    }
-   }
-   norm_trace_sq += norm_trace_sq_partial;
-   // internal check
-   if (std::abs(trace_partial) - 1.0000001 * std::sqrt(norm_trace_sq_partial) * get_block_dim(block_index) > 1.e-15)
-    TRIQS_RUNTIME_ERROR << "|trace| > dim * norm" << trace_partial << " " << std::sqrt(norm_trace_sq_partial) << "  " << trace_abs;
-   if (std::abs(trace_partial - trace(mat)) > 1.e-15) TRIQS_RUNTIME_ERROR << "Internal error : trace and density mismatch";
+   norm_trace_sq += block_traces[bl].norm_sq;
   }
 
 #ifdef CHECK_MATRIX_BOUNDED_BY_BOUND
+  auto dim = get_block_dim(block_index);
   if (std::abs(trace_partial) > 1.000001 * dim * std::exp(-to_sort_lnorm_b[bl].first))
    TRIQS_RUNTIME_ERROR << "Matrix not bounded by the bound ! test is " << std::abs(trace_partial) <<" < " << dim * std::exp(-to_sort_lnorm_b[bl].first);
 #endif
@@ -446,6 +495,135 @@ std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute(double p_yee, double u
  return {norm_trace, rw};
  }
 
+//====== Window mode ======
+
+void impurity_trace::collect_nodes(node n, std::vector<node>& r) const {
+ if (n == nullptr) return;
+ collect_nodes(n->right, r); // the right subtree has the earlier times
+ if (!n->delete_flag) r.push_back(n);
+ collect_nodes(n->left, r);
+}
+
+void impurity_trace::collect_nodes(node n, time_pt const& lower, time_pt const& upper, std::vector<node>& r) const {
+ if (n == nullptr) return;
+ if (n->key > lower) collect_nodes(n->right, lower, upper, r);
+ if ((n->key >= lower) && (n->key < upper) && !n->delete_flag) r.push_back(n);
+ if (n->key < upper) collect_nodes(n->left, lower, upper, r);
+}
+
+// -------- Product of operators in time order ------------------------------
+// M <- op * exp(-(tau - t) * E) * M for each operator, starting from the identity on b, then the evolution to t_end.
+// Two scratch buffers of depth 0 in turn, the third one for the kernels.
+impurity_trace::matrix_view_t impurity_trace::compute_linear_product(std::vector<node> const& nodes, int b,
+                                                                     double t_start, double t_end, workspace_t& ws) {
+ int dim = get_block_dim(b), bc = b, buf = 0;
+ double t = t_start;
+ h_scalar_t* M = ws.get_scratch(0, buf, long(dim) * dim);
+ for (int i = 0; i < dim; ++i)
+  for (int j = 0; j < dim; ++j) M[i * dim + j] = (i == j ? 1 : 0);
+
+ for (auto n : nodes) {
+  int bn = get_op_block_map(n, bc);
+  if (bn == -1) return {-1, nullptr, 0, 0};
+  int dim_c = get_block_dim(bc), dim_n = get_block_dim(bn);
+  if (long(ws.exp.size()) < dim_c) ws.exp.resize(dim_c);
+  double tau = double(n->key);
+  kernels::exp_evolution(dim_c, tau - t, h_diag->get_eigensystem()[bc].eigenvalues.data_start(), ws.exp.data());
+  buf = 1 - buf;
+  h_scalar_t* M_next = ws.get_scratch(0, buf, long(dim_n) * dim);
+  if (auto sp = get_op_block_sparse_matrix(n, bc))
+   kernels::sparse_scaled_gemm(*sp, dim, ws.exp.data(), M, M_next);
+  else
+   block_kernels[bc](dim_n, dim, dim_c, get_op_block_matrix(n, bc).data_start(), ws.exp.data(), M, M_next,
+                     ws.get_scratch(0, 2, long(dim_n) * dim_c));
+  M = M_next;
+  bc = bn;
+  t = tau;
+ }
+
+ int dim_c = get_block_dim(bc);
+ for (int i = 0; i < dim_c; ++i) {
+  double ex = std::exp(-(t_end - t) * get_block_eigenval(bc, i));
+  for (int j = 0; j < dim; ++j) M[i * dim + j] *= ex;
+ }
+ return {bc, M, dim_c, dim};
+}
+
+// -------- Products outside the window ------------------------------
+void impurity_trace::update_window_cache(time_pt const& lower, time_pt const& upper) {
+
+ auto& wc = window_cache;
+ all_nodes.clear();
+ collect_nodes(tree.get_root(), all_nodes);
+ std::vector<node> nodes_below, nodes_above;
+ for (auto n : all_nodes) {
+  if (n->key < lower) nodes_below.push_back(n);
+  if (n->key >= upper) nodes_above.push_back(n);
+ }
+ auto& ws = workspaces[0];
+ auto to_matrix = [](matrix_view_t const& v) {
+  matrix<h_scalar_t> m(v.dim1, v.dim2);
+  for (int i = 0; i < v.dim1; ++i)
+   for (int j = 0; j < v.dim2; ++j) m(i, j) = v(i, j);
+  return m;
+ };
+
+ // R, from tau = 0 to the lower bound, for each block at tau = 0
+ std::vector<int> right_block(n_blocks);
+ std::vector<matrix<h_scalar_t>> right(n_blocks);
+ for (int b = 0; b < n_blocks; ++b) {
+  auto r = compute_linear_product(nodes_below, b, 0, double(lower), ws);
+  right_block[b] = r.block;
+  if (r.block != -1) right[b] = to_matrix(r);
+ }
+
+ // L, from the upper bound to beta, for each block b2 at the upper bound. It ends in the block b at tau = 0 of R.
+ wc.entries.clear();
+ for (int b2 = 0; b2 < n_blocks; ++b2) {
+  auto l = compute_linear_product(nodes_above, b2, double(upper), config->beta(), ws);
+  int b = l.block;
+  if ((b == -1) || (right_block[b] == -1)) continue;
+  wc.entries.push_back({right_block[b], b2, right[b] * to_matrix(l)});
+ }
+ wc.lower = lower;
+ wc.upper = upper;
+ wc.valid = true;
+}
+
+// -------- Trace of a configuration changed in the window only ------------------------------
+// Tr[L W R] = Tr[W (R L)], summed over the blocks at tau = 0. The blocks are computed in parallel as in compute.
+std::pair<h_scalar_t, h_scalar_t> impurity_trace::compute_in_window() {
+
+ time_pt const& lower = window->get_lower();
+ time_pt const& upper = window->get_upper();
+ auto& wc = window_cache;
+ if (!wc.valid || (wc.lower != lower) || (wc.upper != upper)) update_window_cache(lower, upper);
+
+ window_nodes.clear();
+ collect_nodes(tree.get_root(), lower, upper, window_nodes);
+
+ auto entry_trace = [this, &lower, &upper](window_cache_t::entry_t const& e, workspace_t& ws) {
+  auto w = compute_linear_product(window_nodes, e.b1, double(lower), double(upper), ws);
+  h_scalar_t r = 0;
+  if (w.block != e.b2) return r;
+  for (int i = 0; i < w.dim1; ++i)
+   for (int j = 0; j < w.dim2; ++j) r += w(i, j) * e.outside(j, i);
+  return r;
+ };
+
+ int n_entries = wc.entries.size();
+ window_traces.resize(n_entries);
+ if ((block_threads.n_workers() == 1) || (n_entries < 2))
+  for (int k = 0; k < n_entries; ++k) window_traces[k] = entry_trace(wc.entries[k], workspaces[0]);
+ else
+  block_threads.run(n_entries, [&](int k, int w) { window_traces[k] = entry_trace(wc.entries[k], workspaces[w]); });
+
+ h_scalar_t full_trace = 0;
+ for (auto const& x : window_traces) full_trace += x;
+ if (!isfinite(full_trace)) TRIQS_RUNTIME_ERROR << " full_trace not finite" << full_trace;
+ return {full_trace, 1};
+}
+
 // code for check/debug
 #include "./impurity_trace.checks.cpp"
 
@@ -22,6 +22,10 @@
 #include "./configuration.hpp"
 #include "./atom_diag.hpp"
 #include "./solve_parameters.hpp"
+#include "./sliding_window.hpp"
+#include "./node_cache_pool.hpp"
+#include "./thread_pool.hpp"
+#include "./trace_kernels.hpp"
 #include "triqs/utility/rbt.hpp"
 #include <triqs/statistics/histograms.hpp>
 //#define PRINT_CONF_DEBUG
@@ -44,8 +48,10 @@ class impurity_trace {
 
  public:
 
- // construct from the config, the diagonalization of h_loc, and parameters
- impurity_trace(configuration& c, atom_diag const& h_diag, solve_parameters_t const& p, histo_map_t * hist_map);
+ // construct from the config, the diagonalization of h_loc, and parameters. The window of the moves is needed for
+ // trace_method = "window".
+ impurity_trace(configuration& c, atom_diag const& h_diag, solve_parameters_t const& p, histo_map_t* hist_map,
+                sliding_window const* window = nullptr);
 
  ~impurity_trace() { cancel_insert_impl(); } // in case of an exception, we need to remove any trial nodes before cleaning the tree!
 
@@ -68,31 +74,62 @@ class impurity_trace {
   matrix<h_scalar_t> mat;
  };
  arrays::vector<bool_and_matrix> density_matrix; // density_matrix, by block, with a bool to say if it has been recomputed
+ arrays::vector<bool_and_matrix> committed_density_matrix; // density_matrix of the last accepted configuration
  arrays::vector<bool_and_matrix> atomic_rho;     // atomic density matrix (non-normalized)
  double atomic_z;                                // atomic partition function
  double atomic_norm;                             // Frobenius norm of atomic_rho
 
  public:
- arrays::vector<bool_and_matrix> const& get_density_matrix() const { return density_matrix; }
+ /// The density matrix of the current configuration, as computed when it was accepted
+ arrays::vector<bool_and_matrix> const& get_density_matrix() const { return committed_density_matrix; }
+
+ /// The last computed density matrix becomes the one of the current configuration. Called on the confirmation of the
+ /// moves: the density matrix of the next trial is computed in the one of the previous configuration (exchanged).
+ void commit_density_matrix() {
+  if (use_norm_as_weight) std::swap(density_matrix, committed_density_matrix);
+ }
+
+ /// Number of allocations done by the cache of the tree nodes (constant once warmed up)
+ long n_cache_allocations() const { return cache_pool.n_allocations(); }
 
  // ------------------ Cache data ----------------
 
  private:
  // The data stored for each node in tree
+ // The block table, norms and partial products of operator/time evolution matrices are in a slab of the pool.
+ // A node keeps its own slab: a copy takes a new one, an assignment (in rb_tree::delete_node) does not
+ // exchange them since the cache of the assigned node is recomputed anyway.
  struct cache_t {
   double dtau_l = 0, dtau_r = 0; // difference in tau of this node and left and right sub-trees
-  std::vector<int> block_table; // number of blocks limited to 2^15
-  std::vector<arrays::matrix<h_scalar_t>> matrices; // partial product of operator/time evolution matrices
-  std::vector<double> matrix_lnorms; // -ln(norm(matrix))
-  std::vector<bool> matrix_norm_valid; // is the norm of the matrix still valid?
-  cache_t(int n_blocks) : block_table(n_blocks), matrix_lnorms(n_blocks), matrices(n_blocks), matrix_norm_valid(n_blocks) {}
+  node_cache_pool* pool;
+  node_cache_pool::slab_t* slab;
+  cache_t(node_cache_pool* pool) : pool(pool), slab(pool->acquire()) {}
+  cache_t(cache_t const& x) : dtau_l(x.dtau_l), dtau_r(x.dtau_r), pool(x.pool), slab(pool->acquire()) {}
+  cache_t& operator=(cache_t const& x) {
+   dtau_l = x.dtau_l;
+   dtau_r = x.dtau_r;
+   return *this;
+  }
+  ~cache_t() { pool->release(slab); }
  };
 
  struct node_data_t {
   op_desc op;
   cache_t cache;
-  node_data_t(op_desc op, int n_blocks) : op(op), cache(n_blocks) {}
+  std::vector<int> subtree_op_count; // number of operators of each (block_index, dagger) in the subtree, at 2*block_index+dagger
+  node_data_t(op_desc op, node_cache_pool* pool) : op(op), cache(pool) {}
   void reset(op_desc op_new) { op = op_new; }
+
+  // called by the tree when the subtree changes (insertion, rotation, deletion). Trial nodes are not counted.
+  void update_subtree(node_data_t const* l, node_data_t const* r) {
+   std::size_t s = 2 * op.block_index + 2;
+   if (l) s = std::max(s, l->subtree_op_count.size());
+   if (r) s = std::max(s, r->subtree_op_count.size());
+   subtree_op_count.assign(s, 0); // no allocation once the node has seen all blocks
+   if (l) for (std::size_t i = 0; i < l->subtree_op_count.size(); ++i) subtree_op_count[i] += l->subtree_op_count[i];
+   if (r) for (std::size_t i = 0; i < r->subtree_op_count.size(); ++i) subtree_op_count[i] += r->subtree_op_count[i];
+   ++subtree_op_count[2 * op.block_index + op.dagger];
+  }
  };
 
  using rb_tree_t = rb_tree<time_pt, node_data_t, std::greater<time_pt>>;
@@ -101,7 +138,8 @@ class impurity_trace {
 #ifdef EXT_DEBUG
  public:
 #endif
- rb_tree_t tree;       // the red black tree and its nodes
+ node_cache_pool cache_pool; // the slabs for the cache of the nodes. Must outlive the tree and the trial nodes.
+ rb_tree_t tree;             // the red black tree and its nodes
 
  // ---------------- Cache machinery ----------------
  void update_cache();
@@ -117,6 +155,16 @@ class impurity_trace {
  // the minimal eigenvalue of the block b
  double get_block_emin(int b) const { return get_block_eigenval(b, 0); }
 
+ // the vector exp(-dtau * E) for the block b. Taken from the cache of a node (the vector exp and the dtau exp_dtau
+ // it was computed for) if dtau has not changed, recomputed otherwise.
+ double const* get_evolution(double* exp, double& exp_dtau, double dtau, int b) const {
+  if (exp_dtau != dtau) {
+   kernels::exp_evolution(get_block_dim(b), dtau, h_diag->get_eigensystem()[b].eigenvalues.data_start(), exp);
+   exp_dtau = dtau;
+  }
+  return exp;
+ }
+
  // node, block -> image of the block by n->op (the operator)
  int get_op_block_map(node n, int b) const {
   return (n->op.dagger ? h_diag->cdag_connection(n->op.linear_index, b) : h_diag->c_connection(n->op.linear_index, b));
@@ -127,14 +175,119 @@ class impurity_trace {
   return (n->op.dagger ? h_diag->cdag_matrix(n->op.linear_index, b) : h_diag->c_matrix(n->op.linear_index, b));
  }
 
+ // the sparse matrix of n->op, from block b to its image, or nullptr if it is not sparse enough
+ csr_matrix_t const* get_op_block_sparse_matrix(node n, int b) const {
+  return (n->op.dagger ? h_diag->cdag_sparse_matrix(n->op.linear_index, b) : h_diag->c_sparse_matrix(n->op.linear_index, b));
+ }
+
  // recursive function for tree traversal
  int compute_block_table(node n, int b);
  std::pair<int, double> compute_block_table_and_bound(node n, int b, double bound_threshold, bool use_threshold = true);
- std::pair<int, matrix_t> compute_matrix(node n, int b);
+
+ // Kernels for the products C = A * exp(-dtau * E_b) * B, for each block b (compile-time version for small blocks)
+ std::vector<kernels::scaled_gemm_t> block_kernels;
+
+ // Scratch buffers for compute_matrix, three per depth in the tree. They only grow: once warmed up, no allocation.
+ // Each worker computing blocks of the trace has its own.
+ struct workspace_t {
+  std::vector<std::vector<h_scalar_t>> scratch;
+  std::vector<double> exp; // time evolution of compute_linear_product
+  h_scalar_t* get_scratch(int depth, int i, long size) {
+   if (long(scratch.size()) < 3 * (depth + 1)) scratch.resize(3 * (depth + 1));
+   auto& v = scratch[3 * depth + i];
+   if (long(v.size()) < size) v.resize(size);
+   return v.data();
+  }
+ };
+
+ // Result of compute_matrix : the block that b connects to, and a view of the matrix for this block (row-major).
+ // The view points either in the cache of a node or in the scratch buffers of the depth of the call. It is valid
+ // until the next call of compute_matrix at the same depth with the same workspace. data is null for an empty subtree.
+ struct matrix_view_t {
+  int block;
+  h_scalar_t const* data;
+  int dim1, dim2;
+  h_scalar_t operator()(int i, int j) const { return data[i * dim2 + j]; }
+ };
+ matrix_view_t compute_matrix(node n, int b, workspace_t& ws, int depth = 0);
+
+ // Contribution of one block to the trace
+ struct block_trace_t {
+  h_scalar_t trace;   // trace of the block
+  double trace_abs;   // sum of the modulus of the diagonal terms
+  double norm_sq;     // square of the Frobenius norm of the density matrix of the block (only with use_norm_as_weight)
+ };
+ block_trace_t compute_block_trace(int block_index, workspace_t& ws, double dtau_beta, double dtau_0);
+
+ // Work arrays of compute, kept from one call to the next to avoid allocations
+ std::vector<std::pair<double, int>> init_to_sort_lnorm_b, to_sort_lnorm_b; // pairs of lnorm and b to sort in order of bound
+ std::vector<double> bound_cumul;                                            // cumulative sum of the bounds
+ std::vector<block_trace_t> block_traces;                                    // contributions of the sorted blocks
+
+ // Blocks of the trace computed in parallel (no thread if n_trace_threads == 1).
+ // The computations of two different blocks never touch the same entry of the cache, since the
+ // operators connect the blocks one-to-one : the workers can fill the cache concurrently.
+ thread_pool block_threads;
+ std::vector<workspace_t> workspaces; // one per worker of block_threads
 
  void update_cache_impl(node n);
  void update_dtau(node n);
 
+ // ---------------- Window mode ----------------
+ // With trace_method = "window", the trace of a configuration whose changes are all in the time window of the moves
+ // is Tr[W (R L)], W the product of the operators in the window (with the time evolutions from its lower to its
+ // upper bound), R the product from tau = 0 to the window and L from the window to beta. R L is cached for each block
+ // at tau = 0 : a move in the window costs the k_w products of W instead of the O(log n) products of the tree path.
+ // The cache is rebuilt, in O(n) products, at the first trace after the window slides or after the confirmation of a
+ // move outside the window (double insertions or removals, shifts) whose trace is computed with the tree.
+ // The tree is kept up to date in both modes.
+ bool window_mode;
+ sliding_window const* window;
+
+ struct window_cache_t {
+  bool valid = false;
+  time_pt lower, upper; // the window of the cached products
+  struct entry_t {
+   int b1, b2;                  // block at the lower and the upper bound of the window, for a block at tau = 0
+   matrix<h_scalar_t> outside;  // R L, from b2 at the upper bound (through beta = 0) to b1 at the lower bound
+  };
+  std::vector<entry_t> entries; // for the blocks at tau = 0 with a non zero product outside the window
+ } window_cache;
+
+ std::vector<node> window_nodes, all_nodes; // work arrays of compute_in_window and update_window_cache
+ std::vector<h_scalar_t> window_traces;     // contributions of the entries of the window cache
+
+ // The nodes of the subtree of n not flagged for deletion, in increasing time order : all of them, or those in
+ // [lower, upper[
+ void collect_nodes(node n, std::vector<node>& r) const;
+ void collect_nodes(node n, time_pt const& lower, time_pt const& upper, std::vector<node>& r) const;
+
+ // The product of the operators of nodes (in increasing time order) and of the time evolutions between them, from
+ // t_start to t_end, applied to the block b at t_start : {block at t_end, matrix}, in the scratch buffers of ws
+ matrix_view_t compute_linear_product(std::vector<node> const& nodes, int b, double t_start, double t_end,
+                                      workspace_t& ws);
+
+ void update_window_cache(time_pt const& lower, time_pt const& upper);
+ std::pair<h_scalar_t, h_scalar_t> compute_in_window();
+
+ // Are all the changes of the trial configuration in the window ?
+ bool trial_in_window() const {
+  for (int i = 0; i <= trial_node_index; ++i)
+   if (!window->contains(trial_nodes[i]->key)) return false;
+  for (auto const& k : removed_keys)
+   if (!window->contains(k)) return false;
+  return true;
+ }
+
+ // On the confirmation of a move : the cached products stay valid if the move is in their window
+ void check_window_cache() {
+  auto& wc = window_cache;
+  if (!wc.valid) return;
+  auto inside = [&wc](time_pt const& t) { return (t >= wc.lower) && (t < wc.upper); };
+  for (int i = 0; i <= trial_node_index; ++i) wc.valid = wc.valid && inside(trial_nodes[i]->key);
+  for (auto const& k : removed_keys) wc.valid = wc.valid && inside(k);
+ }
+
  bool use_norm_of_matrices_in_cache = true; // When a matrix is computed in cache, its spectral radius replaces the norm estimate
 
  // integrity check
@@ -152,8 +305,8 @@ class impurity_trace {
  int tree_size = 0; // size of the tree +/- the added/deleted node
 
  // make a new detached black node
- std::shared_ptr<rb_tree_t::node_t> make_new_node() const {
-  return std::make_shared<rb_tree_t::node_t>(time_pt{}, node_data_t{{}, n_blocks}, false, 1);
+ std::shared_ptr<rb_tree_t::node_t> make_new_node() {
+  return std::make_shared<rb_tree_t::node_t>(time_pt{}, node_data_t{{}, &cache_pool}, false, 1);
  }
 
  // a pool of trial nodes, ready to be glued in the tree. Max 4 to allow for double insertions
@@ -213,16 +366,18 @@ class impurity_trace {
 
  // confirm the insertion of the nodes, with red black balance
  void confirm_insert() {
+  check_window_cache();
   cancel_insert_impl();                         // remove BST inserted nodes
   for (int i = 0; i <= trial_node_index; ++i) { // then reinsert the nodes in in balanced RBT
    node n = trial_nodes[i].get();
-   tree.insert(n->key, {n->op, n_blocks});
+   tree.insert(n->key, {n->op, &cache_pool});
   }
   trial_node_index = -1;
   update_cache();
   tree_size = tree.size();
   tree.clear_modified();
   check_cache_integrity();
+  commit_density_matrix();
  }
 
  /*************************************************************************
@@ -232,16 +387,36 @@ class impurity_trace {
  std::vector<node> removed_nodes;
  std::vector<time_pt> removed_keys;
 
+ // Number of operators of the tree with dagger and block_index in the subtree of x
+ static int op_count(node x, int block_index, bool dagger) {
+  if (x == nullptr) return 0;
+  auto const& c = x->subtree_op_count;
+  int i = 2 * block_index + dagger;
+  return (i < int(c.size()) ? c[i] : 0);
+ }
+
  public:
+ // The n-th operator of the configuration, in the order of config (decreasing time), in O(log n)
+ std::pair<time_pt, op_desc> get_nth_operator(int n) const {
+  node x = tree.select_node(n);
+  return {x->key, x->op};
+ }
+
  // Find and mark as deleted the nth operator with fixed dagger and block_index
  // n=0 : first operator, n=1, second, etc...
  time_pt try_delete(int n, int block_index, bool dagger) noexcept {
-  // traverse the tree, looking for the nth operator of the correct dagger, block_index
-  int i = 0;
-  node x = find_if(tree, [&](node no) {
-   if (no->op.dagger == dagger && no->op.block_index == block_index) ++i;
-   return i == n + 1;
-  });
+  // go down from the root, skipping the subtrees with fewer such operators than n: O(log n)
+  node x = tree.get_root();
+  while (true) {
+   int n_left = op_count(x->left, block_index, dagger);
+   if (n < n_left) {
+    x = x->left;
+    continue;
+   }
+   n -= n_left;
+   if (x->op.dagger == dagger && x->op.block_index == block_index && (n-- == 0)) break;
+   x = x->right;
+  }
   removed_nodes.push_back(x);             // store the node
   removed_keys.push_back(x->key);         // store the key
   tree.set_modified_from_root_to(x->key); // mark all nodes on path from node to root as modified
@@ -262,6 +437,7 @@ class impurity_trace {
 
  // Confirm deletion: the nodes flagged for deletion are truly deleted
  void confirm_delete() {
+  check_window_cache();
   for (auto& k : removed_keys) tree.delete_node(k); // CANNOT use the node here
   removed_nodes.clear();
   removed_keys.clear();
@@ -269,6 +445,7 @@ class impurity_trace {
   tree_size = tree.size();
   tree.clear_modified();
   check_cache_integrity();
+  commit_density_matrix();
  }
 
  /*************************************************************************
@@ -296,12 +473,13 @@ class impurity_trace {
 
  // Confirm the shift of the node, with red black balance
  void confirm_shift() {
+  check_window_cache();
 
   // Inserted nodes
   cancel_insert_impl();                         //  first remove BST inserted nodes
   for (int i = 0; i <= trial_node_index; ++i) { //  then reinsert the nodes in rb tree, with balancing
    node n = trial_nodes[i].get();
-   tree.insert(n->key, {n->op, n_blocks});
+   tree.insert(n->key, {n->op, &cache_pool});
   }
   trial_node_index = -1;
 
@@ -315,6 +493,7 @@ class impurity_trace {
   tree_size = tree.size();
   tree.clear_modified();
   check_cache_integrity();
+  commit_density_matrix();
  }
 
  private:
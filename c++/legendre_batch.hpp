@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <vector>
+
+namespace cthyb {
+
+/********************************************
+ Sums of v P_l(x) over a batch of pairs (x, v), for l < n_l.
+
+ The Legendre recurrence is run on n_lanes arguments at once, with one
+ partial sum per lane, so that the loop on the lanes is vectorized.
+ ********************************************/
+template <typename T> class legendre_batch {
+
+ public:
+ static constexpr int n_lanes = 8;
+
+ legendre_batch(int n_l) : n_l(n_l), recurrence_a(n_l), recurrence_b(n_l), lane_sums(n_l * n_lanes, 0) {
+  for (int l = 1; l < n_l; ++l) {
+   recurrence_a[l] = (2 * l - 1.0) / l;
+   recurrence_b[l] = (l - 1.0) / l;
+  }
+ }
+
+ /// Add v[c] P_l(x[c]) to the sums, for all the pairs of the batch. xs and vs are padded to full lanes with zeros.
+ void add(std::vector<double>& xs, std::vector<T>& vs) {
+  while (xs.size() % n_lanes) {
+   xs.push_back(0);
+   vs.push_back(0);
+  }
+
+  T* __restrict__ sums = lane_sums.data();
+  for (std::size_t c = 0; c < xs.size(); c += n_lanes) {
+   double const* __restrict__ x = &xs[c];
+   T const* __restrict__ v = &vs[c];
+   double p[n_lanes], p_prev[n_lanes];
+   for (int w = 0; w < n_lanes; ++w) { // l = 0
+    p[w] = 1;
+    p_prev[w] = 0;
+    sums[w] += v[w];
+   }
+   for (int l = 1; l < n_l; ++l) {
+    double a = recurrence_a[l], b = recurrence_b[l];
+    T* __restrict__ sums_l = sums + l * n_lanes;
+    for (int w = 0; w < n_lanes; ++w) {
+     double p_next = a * x[w] * p[w] - b * p_prev[w];
+     p_prev[w] = p[w];
+     p[w] = p_next;
+     sums_l[w] += v[w] * p_next;
+    }
+   }
+  }
+ }
+
+ /// The sum for the order l since the last take(l), which resets it
+ T take(int l) {
+  T r = 0;
+  for (int w = 0; w < n_lanes; ++w) {
+   r += lane_sums[l * n_lanes + w];
+   lane_sums[l * n_lanes + w] = 0;
+  }
+  return r;
+ }
+
+ private:
+ int n_l;
+ std::vector<double> recurrence_a, recurrence_b; // P_l(x) = a_l x P_{l-1}(x) - b_l P_{l-2}(x)
+ std::vector<T> lane_sums;                       // [l * n_lanes + lane]
+};
+}
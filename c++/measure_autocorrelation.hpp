@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "qmc_data.hpp"
+#include "binning.hpp"
+
+namespace cthyb {
+
+// Autocorrelation times of the perturbation order and of the sign, for the calibration of length_cycle.
+// accumulate is called after each move: the sign is recomputed from the data, as the Monte Carlo sign is not available
+// during warmup.
+struct measure_autocorrelation {
+
+ qmc_data const& data;
+ log_binning order, sign;
+
+ measure_autocorrelation(qmc_data const& data) : data(data) {}
+ // --------------------
+
+ void accumulate() {
+
+  order << data.config.size();
+  sign << std::real(data.weight_phase() * data.atomic_reweighting);
+ }
+ // ---------------------------------------------
+
+ // Twice the largest autocorrelation time (averaged over the nodes), so that measurements are nearly uncorrelated
+ int length_cycle(triqs::mpi::communicator const& c) const {
+
+  double tau = std::max(order.autocorrelation_time(), sign.autocorrelation_time());
+  tau = mpi_all_reduce(tau, c) / c.size();
+  return std::max(1, int(std::ceil(2 * tau)));
+ }
+};
+
+}
@@ -39,7 +39,7 @@ struct measure_average_sign {
 
  void accumulate(mc_weight_t s) {
 
-  sign += s * data.atomic_reweighting;
+  sign += s * data.initial_sign * data.atomic_reweighting;
   z += std::abs(data.atomic_reweighting);
  }
  // ---------------------------------------------
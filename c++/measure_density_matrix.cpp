@@ -38,10 +38,9 @@ measure_density_matrix::measure_density_matrix(qmc_data const& data, std::vector
 void measure_density_matrix::accumulate(mc_weight_t s) {
  // we assume here that we are in "Norm" mode, i.e. qmc weight is norm, not trace
 
- // We need to recompute since the density_matrix in the trace is changed at each computatation,
- // in particular at the last failed attempt.
- // So we need to compute it, without any Yee threshold.
- data.imp_trace.compute();
+ // The density matrix of the current configuration was kept by the trace when it was accepted. The Yee threshold
+ // used then does not change it: a computation stopped by the threshold is a rejection.
+ s *= data.initial_sign;
  z += s * data.atomic_reweighting;
  s /= data.atomic_weight; // accumulate matrix / norm since weight is norm * det
 
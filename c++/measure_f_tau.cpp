@@ -0,0 +1,211 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./measure_f_tau.hpp"
+#include "./trace_kernels.hpp"
+
+namespace cthyb {
+
+measure_f_tau::measure_f_tau(block_gf_view<imtime, g_target_t> f_tau, qmc_data const& data, many_body_op_t const& h_int,
+                             atom_diag const& h_diag_full, std::vector<int> const& block_map)
+   : data(data), f_tau(f_tau) {
+ f_tau() = 0.0;
+ q_traces.resize(f_tau.mesh().size());
+
+ // The matrices of [c, h_int]. They connect the blocks as c does, since h_int leaves the blocks of h_loc invariant.
+ // They are computed on the full atomic basis, since the products of c and c^dagger in h_int go through all the
+ // intermediate states, then restricted to the states kept by the energy cutoff (the first ones of each block).
+ auto const& h_diag = data.h_diag;
+ bool truncated = !block_map.empty();
+ q_matrices.resize(h_diag_full.get_fops().size());
+ for (auto const& o : h_diag_full.get_fops()) {
+  auto c = many_body_op_t::make_canonical(false, o.index);
+  auto q = c * h_int - h_int * c;
+  auto& q_mat = q_matrices[o.linear_index];
+  q_mat.resize(h_diag.n_blocks());
+  for (int B = 0; B < h_diag_full.n_blocks(); ++B) {
+   int Bp = h_diag_full.c_connection(o.linear_index, B);
+   if (Bp == -1) continue;
+   int b = (truncated ? block_map[B] : B), bp = (truncated ? block_map[Bp] : Bp);
+   if (b == -1 || bp == -1) continue; // c goes out of the kept states: no matrix in the trace either
+   matrix_t m(h_diag_full.get_block_dim(Bp), h_diag_full.get_block_dim(B));
+   m() = 0;
+   for (auto const& x : q) {
+    auto b_m = h_diag_full.matrix_element_of_monomial(x.monomial, B);
+    if (b_m.first == -1) continue;
+    if (b_m.first != Bp) TRIQS_RUNTIME_ERROR << "The improved estimator needs h_int to leave the blocks of h_loc invariant";
+    m += x.coef * b_m.second;
+   }
+   q_mat[b] = m(range(0, h_diag.get_block_dim(bp)), range(0, h_diag.get_block_dim(b)));
+  }
+ }
+}
+
+// ---------------------------------------------
+
+// The buffer v with room for size elements. It only grows, so that the measures do not allocate in the long run.
+template <typename T> static T* buffer(std::vector<T>& v, long size) {
+ if (long(v.size()) < size) v.resize(size);
+ return v.data();
+}
+
+// For each annihilator k of the configuration (operators O_0 ... O_{n-1} at decreasing times tau_0 > ... > tau_{n-1}),
+// the trace with O_k replaced by [c, h_int]. In each block B, it is Tr(left_k e_{k-1} q_k e_k right_k) with
+//  e_k = exp(-(tau_k - tau_{k+1}) H) (tau_n = 0), e_{-1} = exp(-(beta - tau_0) H)
+//  left_k = e_{-1} O_0 e_0 ... e_{k-2} O_{k-1}, right_k = O_{k+1} e_{k+1} ... O_{n-1} e_{n-1}
+// The right products are computed first, from tau = 0, then the left ones in the loop on k. All matrices are
+// row-major in buffers kept from one measure to the next.
+void measure_f_tau::compute_q_traces() {
+ auto const& h_diag = data.h_diag;
+ double beta = data.config.beta();
+ ops.assign(data.config.begin(), data.config.end());
+ int n = ops.size();
+ op_blocks.resize(n);
+ q_slot.resize(n);
+ if (int(right.size()) < n) right.resize(n);
+ if (int(evolution.size()) < n + 1) evolution.resize(n + 1);
+ for (auto& qt : q_traces) qt.clear();
+ if (n == 0) return;
+ for (int k = 0; k < n; ++k) {
+  auto const& op = ops[k].second;
+  if (op.dagger) continue;
+  q_slot[k] = q_traces[op.block_index].size();
+  q_traces[op.block_index].push_back({ops[k].first, h_scalar_t(0)});
+ }
+
+ auto op_matrix = [&h_diag](op_desc const& op, int b) -> matrix_t const& {
+  return (op.dagger ? h_diag.cdag_matrix(op.linear_index, b) : h_diag.c_matrix(op.linear_index, b));
+ };
+ auto tau = [this, n](int k) { return (k == n ? 0.0 : double(ops[k].first)); };
+ auto dim = [&h_diag](int b) { return h_diag.get_block_dim(b); };
+ auto energies = [&h_diag](int b) { return h_diag.get_eigensystem()[b].eigenvalues.data_start(); };
+
+ for (int B = 0; B < h_diag.n_blocks(); ++B) {
+  // the blocks along the configuration, from tau = 0
+  int b = B;
+  for (int k = n - 1; (k >= 0) && (b != -1); --k) {
+   op_blocks[k] = b;
+   b = (ops[k].second.dagger ? h_diag.cdag_connection(ops[k].second.linear_index, b)
+                             : h_diag.c_connection(ops[k].second.linear_index, b));
+  }
+  if (b != B) continue; // structural zero
+  int dB = dim(B);
+
+  // evolution[k + 1] : the diagonal of e_k, in the block op_blocks[k]. evolution[0] : e_{-1}, in B.
+  kernels::exp_evolution(dB, beta - tau(0), energies(B), buffer(evolution[0], dB));
+  for (int k = 0; k < n; ++k)
+   kernels::exp_evolution(dim(op_blocks[k]), tau(k) - tau(k + 1), energies(op_blocks[k]),
+                          buffer(evolution[k + 1], dim(op_blocks[k])));
+
+  // right[k] : right_k, dim(op_blocks[k]) x dB
+  auto R = buffer(right[n - 1], long(dB) * dB);
+  for (int i = 0; i < dB; ++i)
+   for (int j = 0; j < dB; ++j) R[i * dB + j] = (i == j ? 1 : 0);
+  for (int k = n - 2; k >= 0; --k) {
+   int d = dim(op_blocks[k]), d1 = dim(op_blocks[k + 1]);
+   kernels::scaled_gemm_for_dim(d1)(d, dB, d1, op_matrix(ops[k + 1].second, op_blocks[k + 1]).data_start(),
+                                    evolution[k + 2].data(), right[k + 1].data(), buffer(right[k], long(d) * dB),
+                                    buffer(work, long(d) * d1));
+  }
+
+  // left_k : dB x dl, dl being the dimension of the block on the left of O_k
+  auto L = buffer(left, long(dB) * dB);
+  for (int i = 0; i < dB; ++i)
+   for (int j = 0; j < dB; ++j) L[i * dB + j] = (i == j ? 1 : 0);
+  int dl = dB;
+  for (int k = 0; k < n; ++k) {
+   auto const& op = ops[k].second;
+   int d = dim(op_blocks[k]);
+   if (!op.dagger) { // Tr(left_k e_{k-1} q_k e_k right_k), without forming the products
+    auto const& q = q_matrices[op.linear_index][op_blocks[k]];
+    double const* el = evolution[k].data();
+    double const* er = evolution[k + 1].data();
+    h_scalar_t const* Rk = right[k].data();
+    h_scalar_t tr = 0;
+    for (int a = 0; a < dl; ++a)
+     for (int j = 0; j < d; ++j) {
+      if (q(a, j) == h_scalar_t(0)) continue;
+      h_scalar_t lr = 0;
+      for (int i = 0; i < dB; ++i) lr += L[i * dl + a] * Rk[j * dB + i];
+      tr += el[a] * q(a, j) * er[j] * lr;
+     }
+    q_traces[op.block_index][q_slot[k]].second += tr;
+   }
+   if (k == n - 1) break;
+   // left_{k+1} = left_k e_{k-1} O_k
+   kernels::scaled_gemm_for_dim(dl)(dB, d, dl, L, evolution[k].data(), op_matrix(op, op_blocks[k]).data_start(),
+                                    buffer(left_next, long(dB) * d), buffer(work, long(dB) * dl));
+   std::swap(left, left_next);
+   L = left.data();
+   dl = d;
+  }
+ }
+}
+
+// ---------------------------------------------
+
+void measure_f_tau::accumulate(mc_weight_t s) {
+ num += 1;
+ if (num < 0) TRIQS_RUNTIME_ERROR << " Overflow of counter ";
+
+ // As for the density matrix: the weight of a term of F is its trace times the dets, not the atomic weight
+ s *= data.initial_sign;
+ z += s * data.atomic_reweighting;
+ s /= data.atomic_weight;
+
+ compute_q_traces();
+
+ for (int a = 0; a < f_tau.mesh().size(); ++a) {
+  auto const& qt = q_traces[a];
+  auto g = f_tau[a];
+  foreach(data.dets[a], [&](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
+   // the annihilators are in decreasing time in qt
+   auto it = std::lower_bound(qt.begin(), qt.end(), y.first,
+                              [](std::pair<time_pt, h_scalar_t> const& p, time_pt const& t) { return p.first > t; });
+   g[closest_mesh_pt(double(y.first - x.first))](y.second, x.second) += (y.first >= x.first ? s : -s) * M * it->second;
+  });
+ }
+}
+
+// ---------------------------------------------
+
+void measure_f_tau::collect_results(triqs::mpi::communicator const& c) {
+
+ z = mpi_all_reduce(z, c);
+ for (int a = 0; a < f_tau.mesh().size(); ++a) {
+  auto g = f_tau[a];
+  // Multiply first and last bins by 2 to account for full bins
+  g[0] = g[0] * 2;
+  g[g.mesh().size() - 1] = g[g.mesh().size() - 1] * 2;
+  g = mpi_all_reduce(g, c);
+  g = g / (-real(z) * data.config.beta() * g.mesh().delta());
+  set_tail(g);
+ }
+}
+
+// ---------------------------------------------
+
+void measure_f_tau::set_tail(gf_view<imtime, g_target_t> f) {
+ auto const& d = f.data();
+ int last = f.mesh().size() - 1;
+ for (int i = 0; i < d.shape()[1]; ++i)
+  for (int j = 0; j < d.shape()[2]; ++j) f.singularity()(1)(i, j) = -(d(0, i, j) + d(last, i, j));
+}
+}
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <triqs/gfs.hpp>
+#include "./qmc_data.hpp"
+
+namespace cthyb {
+
+using namespace triqs::gfs;
+
+/********************************************
+ Measure the improved estimator F(tau) (all blocks)
+
+ F_ij(tau) = -< T [c_i, h_int](tau) c^dagger_j(0) >, from which Sigma = F G^{-1} with a much smaller noise than the
+ Dyson equation (H. Hafermann, K. R. Patton and P. Werner, Phys. Rev. B 85, 205106 (2012)).
+ Each pair of operators of the dets contributes as for G(tau), times the trace of the configuration in which the
+ annihilator of the pair is replaced by [c_i, h_int], divided by the atomic weight. These traces are computed
+ for all the annihilators at once with left and right partial products of the configuration, in each block.
+ ********************************************/
+struct measure_f_tau {
+
+ qmc_data const& data;
+ block_gf_view<imtime, g_target_t> f_tau;
+ mc_weight_t z = 0;
+ int64_t num = 0;
+
+ // h_diag_full : diagonalization of h_loc on the full atomic basis. block_map : block of data.h_diag for each of its
+ // blocks (-1 if removed) when data.h_diag is truncated by an energy cutoff, empty otherwise
+ measure_f_tau(block_gf_view<imtime, g_target_t> f_tau, qmc_data const& data, many_body_op_t const& h_int,
+               atom_diag const& h_diag_full, std::vector<int> const& block_map);
+ void accumulate(mc_weight_t s);
+ void collect_results(triqs::mpi::communicator const& c);
+
+ // The 1/iw tail of F is its discontinuity at tau = 0, not known in advance: set it from the data
+ static void set_tail(gf_view<imtime, g_target_t> f);
+
+ private:
+ // q_matrices[linear_index][B] : matrix of [c, h_int] from block B to the block c connects it to (empty if none)
+ std::vector<std::vector<matrix_t>> q_matrices;
+
+ // Work arrays, kept from one measure to the next
+ std::vector<std::pair<time_pt, op_desc>> ops;                     // the operators of the configuration
+ std::vector<int> op_blocks;                                       // op_blocks[k] : block on the right of the operator k
+ std::vector<int> q_slot;                                          // q_slot[k] : index of the annihilator k in q_traces
+ std::vector<std::vector<h_scalar_t>> right;                       // right partial products, cf compute_q_traces
+ std::vector<std::vector<double>> evolution;                       // diagonal time evolutions, cf compute_q_traces
+ std::vector<h_scalar_t> left, left_next, work;                    // left partial products, scratch of the kernels
+ std::vector<std::vector<std::pair<time_pt, h_scalar_t>>> q_traces; // [block] : time of the annihilator, trace
+
+ void compute_q_traces();
+};
+}
@@ -48,7 +48,7 @@ struct measure_g {
   num += 1;
   if (num < 0) TRIQS_RUNTIME_ERROR << " Overflow of counter ";
 
-  s *= data.atomic_reweighting;
+  s *= data.initial_sign * data.atomic_reweighting;
   z += s;
 
   foreach(data.dets[a_level], [this, s](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#include "./measure_g2.hpp"
+
+namespace cthyb {
+
+measure_g2::measure_g2(std::vector<g2_t>& g2, qmc_data const& data, int n_f, int n_b, int n_threads)
+   : data(data),
+     g2(g2),
+     n_blocks(data.dets.size()),
+     n_f(n_f),
+     n_b(n_b),
+     n_w(2 * n_f + n_b - 1),
+     beta(data.config.beta()),
+     pool(std::make_shared<thread_pool>(n_threads)) {
+ if ((n_f < 1) || (n_b < 1)) TRIQS_RUNTIME_ERROR << "G2 needs at least one fermionic and one bosonic frequency";
+ g2.resize(n_blocks * n_blocks);
+ for (int A = 0; A < n_blocks; ++A)
+  for (int B = 0; B < n_blocks; ++B) {
+   int dA = data.n_inner[A], dB = data.n_inner[B];
+   g2[A * n_blocks + B].resize(make_shape(n_b, 2 * n_f, 2 * n_f, dA, dA, dB, dB));
+   g2[A * n_blocks + B]() = 0;
+  }
+ m_w.resize(n_blocks);
+}
+
+// ---------------------------------------------
+
+// M(w1, w2) of block A, from the inverse matrix of its det. The operators are taken in the order of the det
+// (decreasing times), so that the position of an operator is found by bisection.
+void measure_g2::compute_m_w(int A) {
+ auto const& det = data.dets[A];
+ int k = det.size(), dim = data.n_inner[A];
+ auto& m = m_w[A];
+ m.resize(n_w * dim, n_w * dim);
+ if (k == 0) {
+  m() = 0;
+  return;
+ }
+
+ tau_x.resize(k);
+ tau_y.resize(k);
+ for (int i = 0; i < k; ++i) {
+  tau_x[i] = det.get_x(i).first;
+  tau_y[i] = det.get_y(i).first;
+ }
+ auto position = [](std::vector<time_pt> const& v, time_pt const& t) {
+  return int(std::lower_bound(v.begin(), v.end(), t, std::greater<time_pt>()) - v.begin());
+ };
+ m_inv.resize(k, k);
+ foreach(det, [&](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
+  m_inv(position(tau_y, y.first), position(tau_x, x.first)) = M;
+ });
+
+ // exp_y(n * dim + a, j) = e^{i w_n tau_j} if the c number j is in a, exp_x(i, n * dim + b) = e^{-i w_n tau_i} idem for c^dagger
+ exp_y.resize(n_w * dim, k);
+ exp_x.resize(k, n_w * dim);
+ exp_y() = 0;
+ exp_x() = 0;
+ for (int j = 0; j < k; ++j) {
+  double t = double(tau_y[j]);
+  dcomplex e = std::exp(dcomplex(0, (1 - 2 * n_f) * M_PI * t / beta)), step = std::exp(dcomplex(0, 2 * M_PI * t / beta));
+  int a = det.get_y(j).second;
+  for (int n = 0; n < n_w; ++n, e *= step) exp_y(n * dim + a, j) = e;
+ }
+ for (int i = 0; i < k; ++i) {
+  double t = double(tau_x[i]);
+  dcomplex e = std::exp(dcomplex(0, -(1 - 2 * n_f) * M_PI * t / beta)), step = std::exp(dcomplex(0, -2 * M_PI * t / beta));
+  int b = det.get_x(i).second;
+  for (int n = 0; n < n_w; ++n, e *= step) exp_x(i, n * dim + b) = e;
+ }
+ m = exp_y * (m_inv * exp_x);
+}
+
+// ---------------------------------------------
+
+// g2[A, B] += s * (direct - exchange) on the whole box. A task is a bosonic frequency and a tile of w: the tasks write
+// in different parts of g2. The loop on w' is cut in tiles too, so that the blocks of M used by a tile stay in cache.
+void measure_g2::assemble(int A, int B, dcomplex s) {
+ auto& g = g2[A * n_blocks + B];
+ auto const& mA = m_w[A];
+ auto const& mB = m_w[B];
+ int dA = data.n_inner[A], dB = data.n_inner[B];
+ int n_tiles = (2 * n_f + tile - 1) / tile;
+ bool exchange = (A == B);
+
+ pool->run(n_b * n_tiles, [&](int task, int) {
+  int W = task / n_tiles, n1_start = (task % n_tiles) * tile, n1_end = std::min(n1_start + tile, 2 * n_f);
+  for (int n2_start = 0; n2_start < 2 * n_f; n2_start += tile) {
+   int n2_end = std::min(n2_start + tile, 2 * n_f);
+   for (int n1 = n1_start; n1 < n1_end; ++n1)
+    for (int n2 = n2_start; n2 < n2_end; ++n2) {
+     dcomplex* r = &g(W, n1, n2, 0, 0, 0, 0);
+     for (int a = 0; a < dA; ++a)
+      for (int b = 0; b < dA; ++b) {
+       dcomplex direct = s * mA(n1 * dA + a, (n1 + W) * dA + b);
+       for (int c = 0; c < dB; ++c)
+        for (int d = 0; d < dB; ++d, ++r) {
+         dcomplex x = direct * mB((n2 + W) * dB + c, n2 * dB + d);
+         if (exchange) x -= s * mA(n1 * dA + a, n2 * dA + d) * mA((n2 + W) * dA + c, (n1 + W) * dA + b);
+         *r += x;
+        }
+      }
+    }
+  }
+ });
+}
+
+// ---------------------------------------------
+
+void measure_g2::accumulate(mc_weight_t s) {
+ num += 1;
+ if (num < 0) TRIQS_RUNTIME_ERROR << " Overflow of counter ";
+
+ s *= data.initial_sign * data.atomic_reweighting;
+ z += s;
+
+ for (int A = 0; A < n_blocks; ++A) compute_m_w(A);
+ for (int A = 0; A < n_blocks; ++A)
+  for (int B = 0; B < n_blocks; ++B)
+   if ((data.dets[A].size() > 0) && (data.dets[B].size() > 0)) assemble(A, B, s); // else M^A or M^B is 0
+}
+
+// ---------------------------------------------
+
+void measure_g2::collect_results(triqs::mpi::communicator const& c) {
+
+ z = mpi_all_reduce(z, c);
+ for (auto& g : g2) {
+  g = mpi_all_reduce(g, c);
+  g /= beta * real(z);
+ }
+}
+}
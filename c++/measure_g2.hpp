@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./qmc_data.hpp"
+#include "./thread_pool.hpp"
+#include <memory>
+
+namespace cthyb {
+
+/********************************************
+ Measure the two-particle Green's function in Matsubara frequencies (all pairs of blocks)
+
+ G2^{AB}_{abcd}(iW, iw, iw') = int e^{iw t1 - i(w+W) t2 + i(w'+W) t3 - iw' t4} < T c_Aa(t1) c^dagger_Ab(t2) c_Bc(t3) c^dagger_Bd(t4) >
+ is estimated from the M(w1, w2)_ab = sum_{y in a, x in b} e^{i w1 tau_y} M_{y,x} e^{-i w2 tau_x} of the dets as
+ (1/beta) < M^A(w, w+W)_ab M^B(w'+W, w')_cd - delta_AB M^A(w, w')_ad M^A(w'+W, w+W)_cb >.
+
+ For each measure, the M(w1, w2) of a block are computed on the n_w = 2 n_f + n_b - 1 frequencies used by the box with
+ two matrix products (exponentials x inverse matrix x exponentials), then G2 is assembled on the box by tiles of
+ frequencies, the bosonic frequencies and the tiles of w being shared among the threads.
+ g2[A * n_blocks + B](W, w, w', a, b, c, d), W = 0 ... n_b - 1, w, w' = -n_f ... n_f - 1: the memory is fixed by the box.
+ ********************************************/
+struct measure_g2 {
+
+ using g2_t = arrays::array<dcomplex, 7>;
+
+ qmc_data const& data;
+ std::vector<g2_t>& g2;
+ int n_blocks, n_f, n_b, n_w;
+ double beta;
+ mc_weight_t z = 0;
+ int64_t num = 0;
+
+ measure_g2(std::vector<g2_t>& g2, qmc_data const& data, int n_f, int n_b, int n_threads);
+ void accumulate(mc_weight_t s);
+ void collect_results(triqs::mpi::communicator const& c);
+
+ private:
+ static constexpr int tile = 8;      // tiles of tile x tile fermionic frequencies in the assembly
+ std::shared_ptr<thread_pool> pool;  // shared by the copies of the measure
+ std::vector<matrix<dcomplex>> m_w;  // [A] : M(w1, w2)_ab at (n1 * dim + a, n2 * dim + b), n1, n2 = w + n_f in [0, n_w[
+
+ // Work arrays, kept from one measure to the next
+ std::vector<time_pt> tau_x, tau_y;
+ matrix<dcomplex> m_inv, exp_y, exp_x;
+
+ void compute_m_w(int A);
+ void assemble(int A, int B, dcomplex s);
+};
+}
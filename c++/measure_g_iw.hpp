@@ -0,0 +1,132 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <triqs/gfs.hpp>
+#include "./qmc_data.hpp"
+#include <cmath>
+
+namespace cthyb {
+
+using namespace triqs::gfs;
+
+// Measure the Matsubara Green's function G(iw_n) (one block), directly from the pairs of operators of the det.
+// The sum over the pairs of M * exp(i w_n (tau_y - tau_x)) is a non-equispaced Fourier transform, computed by Gaussian
+// gridding (L. Greengard and J.-Y. Lee, SIAM Review 46, 443 (2004)): each pair is spread on the 2 * m_sp closest points
+// of a uniform tau grid with twice as many points as frequencies, summed over the whole run. The cost of a measure is
+// O(k^2 m_sp), the transformation of the grid to the frequencies is done once, in collect_results.
+// The grid is kept by the caller, as the partial sums of the other measures, e.g. for the checkpoints.
+struct measure_g_iw {
+
+ qmc_data const& data;
+ gf_view<imfreq> g_iw;
+ int a_level;
+ double beta;
+ mc_weight_t z;
+ int64_t num;
+
+ static constexpr int m_sp = 12;   // half width of the spreading: relative precision ~ 1e-11
+ int n_center;                     // index of the frequency in the middle of the mesh
+ int n_grid;                       // number of points of the grid
+ double w_center;                  // frequency n_center
+ double h, tau_g;                  // grid step, and width of the Gaussian, for the angle 2 pi tau / beta
+ std::vector<double> e3;           // exp(-(l h)^2 / (4 tau_g)), l = 0 ... m_sp
+ arrays::array<dcomplex, 3>& grid; // grid(i, j, point)
+
+ // The index n of the Matsubara frequency (2n+1) pi / beta
+ int matsubara_index(dcomplex iw) const { return int(std::lround((iw.imag() * beta / M_PI - 1) / 2)); }
+
+ measure_g_iw(int a_level, gf_view<imfreq> g_iw, arrays::array<dcomplex, 3>& grid, qmc_data const& data)
+    : data(data), g_iw(g_iw), a_level(a_level), beta(data.config.beta()), grid(grid) {
+  g_iw() = 0.0;
+  z = 0;
+  num = 0;
+
+  int n_min = 0, n_max = 0;
+  bool first = true;
+  for (auto const& iw : g_iw.mesh()) {
+   int n = matsubara_index(iw);
+   n_min = (first ? n : std::min(n_min, n));
+   n_max = (first ? n : std::max(n_max, n));
+   first = false;
+  }
+  int n_modes = n_max - n_min + 1;
+  n_center = n_min + n_modes / 2;
+  w_center = (2 * n_center + 1) * M_PI / beta;
+  n_grid = std::max(2 * n_modes, 2 * m_sp); // oversampling r = 2, more for the smallest meshes
+  h = 2 * M_PI / n_grid;
+  double r = double(n_grid) / n_modes;
+  tau_g = M_PI * m_sp / (r * (r - 0.5) * n_modes * n_modes);
+  for (int l = 0; l <= m_sp; ++l) e3.push_back(std::exp(-(l * h) * (l * h) / (4 * tau_g)));
+  int dim = get_target_shape(g_iw)[0];
+  grid.resize(dim, dim, n_grid);
+  grid() = 0;
+ }
+ // --------------------
+
+ void accumulate(mc_weight_t s) {
+  num += 1;
+  if (num < 0) TRIQS_RUNTIME_ERROR << " Overflow of counter ";
+
+  s *= data.initial_sign * data.atomic_reweighting;
+  z += s;
+
+  foreach(data.dets[a_level], [this, s](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
+   // as in measure_g, with the antiperiodicity in beta of exp(i w_n tau)
+   double tau = double(y.first - x.first);
+   dcomplex c = dcomplex((y.first >= x.first ? s : -s) * M) * std::exp(dcomplex(0, w_center * tau));
+
+   // spread c on the points m0 - m_sp + 1 ... m0 + m_sp of the grid around the angle theta
+   double theta = 2 * M_PI * tau / beta;
+   int m0 = std::min(int(theta / h), n_grid - 1);
+   double xi = theta - m0 * h;
+   double e1 = std::exp(-xi * xi / (4 * tau_g)), e2 = std::exp(xi * h / (2 * tau_g));
+   dcomplex* g = &grid(y.second, x.second, 0);
+   double p = e1;
+   for (int l = 0; l <= m_sp; ++l, p *= e2) g[(m0 + l) % n_grid] += c * (p * e3[l]);
+   p = e1 / e2;
+   for (int l = 1; l < m_sp; ++l, p /= e2) g[(m0 - l + n_grid) % n_grid] += c * (p * e3[l]);
+  });
+ }
+ // ---------------------------------------------
+
+ void collect_results(triqs::mpi::communicator const& c) {
+
+  z = mpi_all_reduce(z, c);
+  grid = mpi_all_reduce(grid, c);
+
+  // Fourier coefficients of the grid, divided by those of the Gaussian
+  int dim = first_dim(grid);
+  for (auto const& iw : g_iw.mesh()) {
+   int k = matsubara_index(iw) - n_center;
+   double norm = -std::sqrt(M_PI / tau_g) * std::exp(k * k * tau_g) / (n_grid * beta * real(z));
+   dcomplex step = std::exp(dcomplex(0, k * h));
+   for (int i = 0; i < dim; ++i)
+    for (int j = 0; j < dim; ++j) {
+     dcomplex const* g = &grid(i, j, 0);
+     dcomplex r = 0, phase = 1;
+     for (int m = 0; m < n_grid; ++m, phase *= step) r += g[m] * phase;
+     g_iw[iw](i, j) = norm * r;
+    }
+  }
+  g_iw.singularity()(1) = 1.0;
+ }
+};
+}
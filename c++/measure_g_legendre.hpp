@@ -21,14 +21,16 @@
 #pragma once
 #include <triqs/gfs.hpp>
 #include <triqs/gfs/functions/functions.hpp>
-#include <triqs/utility/legendre.hpp>
 #include "qmc_data.hpp"
+#include "legendre_batch.hpp"
 
 namespace cthyb {
 
 using namespace triqs::gfs;
 
 // Measure Legendre Green's function (one block)
+// The pairs of operators of the det are first sorted by matrix element (i,j) into batches, whose sums over the Legendre
+// polynomials are computed by legendre_batch, then added once per element and order to the (contiguous) data of g_l.
 struct measure_g_legendre {
 
  qmc_data const& data;
@@ -38,11 +40,24 @@ struct measure_g_legendre {
  mc_weight_t z;
  int64_t num;
 
+ int n_l, dim;
+ legendre_batch<mc_weight_t> batch;
+ std::vector<std::vector<double>> batch_x;             // [i * dim + j] : arguments x = 2 tau / beta - 1 of the pairs
+ std::vector<std::vector<mc_weight_t>> batch_val;      // [i * dim + j] : corresponding signed weights
+
  measure_g_legendre(int a_level, gf_view<legendre> g_l, qmc_data const& data)
-    : data(data), g_l(g_l), a_level(a_level), beta(data.config.beta()) {
+    : data(data),
+      g_l(g_l),
+      a_level(a_level),
+      beta(data.config.beta()),
+      n_l(g_l.mesh().size()),
+      dim(g_l.data().shape()[1]),
+      batch(n_l) {
   g_l() = 0.0;
   z = 0;
   num = 0;
+  batch_x.resize(dim * dim);
+  batch_val.resize(dim * dim);
  }
  // --------------------
 
@@ -50,18 +65,24 @@ struct measure_g_legendre {
   num += 1;
   if (num < 0) TRIQS_RUNTIME_ERROR << " Overflow of counter ";
 
-  s *= data.atomic_reweighting;
+  s *= data.initial_sign * data.atomic_reweighting;
   z += s;
 
-  auto Tn = triqs::utility::legendre_generator();
-
-  foreach(data.dets[a_level], [this, s, &Tn](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
-   double poly_arg = 2*double(y.first - x.first)/beta - 1.0;
-   Tn.reset(poly_arg);
+  for (auto& b : batch_x) b.clear();
+  for (auto& b : batch_val) b.clear();
 
-   auto val = (y.first >= x.first ? s : -s) * M;
-   for (auto l : g_l.mesh()) this->g_l[l](y.second, x.second) += val * Tn.next();
+  foreach(data.dets[a_level], [this, s](std::pair<time_pt, int> const& x, std::pair<time_pt, int> const& y, det_scalar_t M) {
+   int ij = y.second * dim + x.second;
+   batch_x[ij].push_back(2 * double(y.first - x.first) / beta - 1.0);
+   batch_val[ij].push_back((y.first >= x.first ? s : -s) * M);
   });
+
+  for (int i = 0; i < dim; ++i)
+   for (int j = 0; j < dim; ++j) {
+    if (batch_x[i * dim + j].empty()) continue;
+    batch.add(batch_x[i * dim + j], batch_val[i * dim + j]);
+    for (int l = 0; l < n_l; ++l) g_l.data()(l, i, j) += batch.take(l);
+   }
  }
  // ---------------------------------------------
 
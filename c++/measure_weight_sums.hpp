@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "qmc_data.hpp"
+
+namespace cthyb {
+
+// The running sums of the weights, with and without the sign, as the normalizations of measure_g (z) and of
+// measure_average_sign, and the number of measures (num). Read during the accumulation for the target error, as the
+// weights of the chains, and saved in the checkpoints.
+struct weight_sums_t {
+ mc_weight_t signed_sum = 0;
+ double abs_sum = 0;
+ int64_t num = 0;
+};
+
+struct measure_weight_sums {
+
+ qmc_data const& data;
+ weight_sums_t & sums;
+
+ measure_weight_sums(qmc_data const& data, weight_sums_t & sums) : data(data), sums(sums) { sums = {}; }
+ // --------------------
+
+ void accumulate(mc_weight_t s) {
+
+  sums.num += 1;
+  sums.signed_sum += s * data.initial_sign * data.atomic_reweighting;
+  sums.abs_sum += std::abs(data.atomic_reweighting);
+ }
+ // ---------------------------------------------
+
+ void collect_results(triqs::mpi::communicator const& c) {}
+};
+
+}
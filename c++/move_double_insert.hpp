@@ -122,25 +122,14 @@ class move_insert_c_c_cdag_cdag {
   // Computation of det ratio
   auto& det1 = data.dets[block_index1];
   auto& det2 = data.dets[block_index2];
-  int det1_size = det1.size();
-  int det2_size = det2.size();
   det_scalar_t det_ratio;
 
   // Find the position for insertion in the determinant
   // NB : the determinant stores the C in decreasing time order.
-  int num_c_dag1, num_c1, num_c_dag2, num_c2;
-  for (num_c_dag1 = 0; num_c_dag1 < det1_size; ++num_c_dag1) {
-   if (det1.get_x(num_c_dag1).first < tau1) break;
-  }
-  for (num_c1 = 0; num_c1 < det1_size; ++num_c1) {
-   if (det1.get_y(num_c1).first < tau2) break;
-  }
-  for (num_c_dag2 = 0; num_c_dag2 < det2_size; ++num_c_dag2) {
-   if (det2.get_x(num_c_dag2).first < tau3) break;
-  }
-  for (num_c2 = 0; num_c2 < det2_size; ++num_c2) {
-   if (det2.get_y(num_c2).first < tau4) break;
-  }
+  int num_c_dag1 = det_position(det1, true, tau1);
+  int num_c1 = det_position(det1, false, tau2);
+  int num_c_dag2 = det_position(det2, true, tau3);
+  int num_c2 = det_position(det2, false, tau4);
 
   // Insert in the det. Returns the ratio of dets (Cf det_manip doc).
   if (block_index1 == block_index2) {
@@ -72,8 +72,9 @@ class move_insert_c_cdag {
   op2 = op_desc{block_index, rs2, false, data.linindex[std::make_pair(block_index, rs2)]};
 
   // Choice of times for insertion. Find the time as double and them put them on the grid.
-  tau1 = data.tau_seg.get_random_pt(rng);
-  tau2 = data.tau_seg.get_random_pt(rng);
+  // They are in the time window of the insertions (the whole [0, beta[ by default).
+  tau1 = data.window.get_random_pt(rng);
+  tau2 = data.window.get_random_pt(rng);
 
 #ifdef EXT_DEBUG
   std::cerr << "* Proposing to insert:" << std::endl;
@@ -101,23 +102,19 @@ class move_insert_c_cdag {
 
   // Computation of det ratio
   auto& det = data.dets[block_index];
-  int det_size = det.size();
 
   // Find the position for insertion in the determinant
   // NB : the determinant stores the C in decreasing time order.
-  int num_c_dag, num_c;
-  for (num_c_dag = 0; num_c_dag < det_size; ++num_c_dag) {
-   if (det.get_x(num_c_dag).first < tau1) break;
-  }
-  for (num_c = 0; num_c < det_size; ++num_c) {
-   if (det.get_y(num_c).first < tau2) break;
-  }
+  int num_c_dag = det_position(det, true, tau1);
+  int num_c = det_position(det, false, tau2);
 
   // Insert in the det. Returns the ratio of dets (Cf det_manip doc).
   auto det_ratio = det.try_insert(num_c_dag, num_c, {tau1, op1.inner_index}, {tau2, op2.inner_index});
 
-  // proposition probability
-  mc_weight_t t_ratio = std::pow(block_size * config.beta() / double(det.size() + 1), 2);
+  // proposition probability. The reverse move removes one of the operators of the block in the window.
+  int n_c_dag_in_window = data.window.find_in_window(det, true).second;
+  int n_c_in_window = data.window.find_in_window(det, false).second;
+  mc_weight_t t_ratio = std::pow(block_size * data.window.width(), 2) / double((n_c_dag_in_window + 1) * (n_c_in_window + 1));
 
   // For quick abandon
   double random_number = rng.preview();
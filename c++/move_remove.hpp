@@ -69,11 +69,13 @@ class move_remove_c_cdag {
 
   auto& det = data.dets[block_index];
 
-  // Pick up a couple of C, Cdagger to remove at random
+  // Pick up a couple of C, Cdagger to remove at random, in the time window of the removals (the whole [0, beta[ by default)
   // Remove the operators from the traces
   int det_size = det.size();
   if (det_size == 0) return 0; // nothing to remove
-  int num_c_dag = rng(det_size), num_c = rng(det_size);
+  auto c_dag_in_window = data.window.find_in_window(det, true), c_in_window = data.window.find_in_window(det, false);
+  if ((c_dag_in_window.second == 0) || (c_in_window.second == 0)) return 0; // nothing to remove in the window
+  int num_c_dag = c_dag_in_window.first + rng(c_dag_in_window.second), num_c = c_in_window.first + rng(c_in_window.second);
 
 #ifdef EXT_DEBUG
   std::cerr << "* Proposing to remove: ";
@@ -92,7 +94,8 @@ class move_remove_c_cdag {
   auto det_ratio = det.try_remove(num_c_dag, num_c);
 
   // proposition probability
-  auto t_ratio = std::pow(block_size * config.beta() / double(det_size), 2); // Size of the det before the try_delete!
+  auto t_ratio = std::pow(block_size * data.window.width(), 2) /
+                 double(c_dag_in_window.second * c_in_window.second); // Sizes before the try_delete!
 
   // For quick abandon
   double random_number = rng.preview();
@@ -78,10 +78,8 @@ class move_shift_operator {
   const int op_pos_in_config = rng(config_size);
 
   // --- Find operator (and its characteristics) from the configuration
-  auto itconfig = config.begin();
-  for (int i=0; i<op_pos_in_config; ++i, ++itconfig); // Get to right position in config
-  tau_old = (*itconfig).first;
-  op_old = (*itconfig).second;
+  // The tree of the trace holds the operators of config in the same order, with subtree counts
+  std::tie(tau_old, op_old) = data.imp_trace.get_nth_operator(op_pos_in_config);
   block_index = op_old.block_index;
   auto is_dagger = op_old.dagger;
 
@@ -113,12 +111,8 @@ class move_shift_operator {
     // Find the c and c_dag operators at the right of op_old (at smaller times)
     // They could be the last entries (earliest times)
 
-    for (ic_dag = 0; ic_dag < det_size; ++ic_dag) { // c_dag
-     if (det.get_x(ic_dag).first < tau_old) break;
-    }
-    for (ic = 0; ic < det_size; ++ic) { // c
-     if (det.get_y(ic).first < tau_old) break;
-    }
+    ic_dag = det_position(det, true, tau_old); // c_dag
+    ic = det_position(det, false, tau_old);    // c
 
     op_pos_in_det = (is_dagger ? ic_dag : ic); // This finds the operator on the right
     --op_pos_in_det; // Rewind by one to find the operator
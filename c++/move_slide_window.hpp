@@ -0,0 +1,43 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./qmc_data.hpp"
+
+namespace cthyb {
+
+// Move the time window of the insertions and removals. The configuration is unchanged: always accepted.
+class move_slide_window {
+
+ qmc_data& data;
+
+ public:
+ move_slide_window(qmc_data& data) : data(data) {}
+
+ mc_weight_t attempt() { return 1; }
+
+ mc_weight_t accept() {
+  data.window.slide();
+  return 1;
+ }
+
+ void reject() {}
+};
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./atom_diag.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace cthyb {
+
+/********************************************
+ Slab allocator for the cache of the trace tree.
+
+ The whole cache of a node (block table, norms, validity flags, time
+ evolution vectors and partial products of all blocks) lives in a single
+ buffer, a slab.
+ Slabs of deleted nodes go to a free list and are recycled, with their
+ capacity, by the next nodes: once warmed up, there is no allocation.
+ ********************************************/
+class node_cache_pool {
+
+ public:
+ class slab_t {
+  friend class node_cache_pool;
+  std::unique_ptr<char[]> buffer; // the single allocation holding everything below
+  long matrix_capacity = 0;       // number of h_scalar_t available for the matrices
+  long* offsets = nullptr;        // offsets[b] : position of the matrix of block b in matrix_data
+  h_scalar_t* matrix_data = nullptr;
+  long const* evolution_offsets = nullptr; // evolution_offsets[b] : position of the vectors of block b in exp_*_data
+  double *exp_r_data = nullptr, *exp_l_data = nullptr;
+
+  public:
+  int* block_table = nullptr;        // block_table[b] : block that b connects to through the subtree, or -1
+  double* matrix_lnorms = nullptr;   // -ln(norm(matrix))
+  bool* matrix_norm_valid = nullptr; // is the norm of the matrix still valid?
+
+  // Time evolution vectors exp(-dtau_r * E_b) and exp(-dtau_l * E_b) for the block b on the right (left) of the node,
+  // and the dtau for which they were computed (NaN if never computed)
+  double* exp_dtau_r = nullptr;
+  double* exp_dtau_l = nullptr;
+  double* exp_r(int b) { return exp_r_data + evolution_offsets[b]; }
+  double* exp_l(int b) { return exp_l_data + evolution_offsets[b]; }
+
+  // The matrix of block b : dim(block_table[b]) x dim(b), row-major
+  h_scalar_t* matrix(int b) { return matrix_data + offsets[b]; }
+  h_scalar_t const* matrix(int b) const { return matrix_data + offsets[b]; }
+ };
+
+ node_cache_pool(atom_diag const& h_diag) : n_blocks(h_diag.n_blocks()), block_dims(h_diag.n_blocks()) {
+  total_dim = 0;
+  for (int b = 0; b < n_blocks; ++b) {
+   block_dims[b] = h_diag.get_block_dim(b);
+   evolution_offsets.push_back(total_dim);
+   total_dim += block_dims[b];
+  }
+  // the header (norms, evolution vectors, block table, offsets, flags) is padded so that the matrices are aligned
+  header_size = n_blocks * (3 * sizeof(double) + sizeof(long) + sizeof(int) + sizeof(bool)) + 2 * total_dim * sizeof(double);
+  header_size = (header_size + alignment - 1) / alignment * alignment;
+ }
+
+ node_cache_pool(node_cache_pool const&) = delete;
+ node_cache_pool& operator=(node_cache_pool const&) = delete;
+
+ /// Get a slab, from the free list if possible
+ slab_t* acquire() {
+  if (!free_list.empty()) {
+   auto s = free_list.back();
+   free_list.pop_back();
+   return s;
+  }
+  slabs.emplace_back(new slab_t);
+  auto s = slabs.back().get();
+  reallocate(s, 0);
+  std::fill(s->block_table, s->block_table + n_blocks, -1);
+  std::fill(s->matrix_lnorms, s->matrix_lnorms + n_blocks, 0.0);
+  std::fill(s->offsets, s->offsets + n_blocks, 0l);
+  std::fill(s->matrix_norm_valid, s->matrix_norm_valid + n_blocks, false);
+  std::fill(s->exp_dtau_r, s->exp_dtau_r + n_blocks, std::numeric_limits<double>::quiet_NaN());
+  std::fill(s->exp_dtau_l, s->exp_dtau_l + n_blocks, std::numeric_limits<double>::quiet_NaN());
+  return s;
+ }
+
+ /// Give back a slab to the free list
+ void release(slab_t* s) {
+  if (s) free_list.push_back(s);
+ }
+
+ /// Place the matrices in the slab according to its block table. Grow the slab if necessary.
+ /// The content of the matrices is not preserved : they must be flagged as invalid before.
+ void layout_matrices(slab_t* s) {
+  long size = 0;
+  for (int b = 0; b < n_blocks; ++b) {
+   s->offsets[b] = size;
+   int bp = s->block_table[b];
+   if (bp >= 0) size += long(block_dims[bp]) * block_dims[b];
+  }
+  if (size > s->matrix_capacity) reallocate(s, std::max(size, 2 * s->matrix_capacity));
+ }
+
+ /// Number of allocations done by the pool since its construction
+ long n_allocations() const { return _n_allocations; }
+
+ /// Number of slabs (in use or in the free list)
+ int n_slabs() const { return slabs.size(); }
+
+ private:
+ static constexpr std::size_t alignment = 64;
+ int n_blocks;
+ std::vector<int> block_dims;
+ std::vector<long> evolution_offsets; // position of the evolution vectors of each block
+ long total_dim;                      // sum of the dimensions of the blocks
+ std::size_t header_size;
+ std::vector<std::unique_ptr<slab_t>> slabs; // all the slabs, owned by the pool
+ std::vector<slab_t*> free_list;             // the slabs not used by any node
+ long _n_allocations = 0;
+
+ // (Re)allocate the buffer of s, keeping the header
+ void reallocate(slab_t* s, long matrix_capacity) {
+  std::unique_ptr<char[]> buf(new char[header_size + matrix_capacity * sizeof(h_scalar_t) + alignment]);
+  ++_n_allocations;
+  // align the start of the buffer
+  char* p = buf.get();
+  p += (alignment - reinterpret_cast<std::uintptr_t>(p) % alignment) % alignment;
+  if (s->buffer) std::memcpy(p, s->matrix_lnorms, header_size); // the header starts with the norms
+  auto lnorms = reinterpret_cast<double*>(p);
+  s->matrix_lnorms = lnorms;
+  s->exp_dtau_r = lnorms + n_blocks;
+  s->exp_dtau_l = s->exp_dtau_r + n_blocks;
+  s->exp_r_data = s->exp_dtau_l + n_blocks;
+  s->exp_l_data = s->exp_r_data + total_dim;
+  s->offsets = reinterpret_cast<long*>(s->exp_l_data + total_dim);
+  s->block_table = reinterpret_cast<int*>(s->offsets + n_blocks);
+  s->matrix_norm_valid = reinterpret_cast<bool*>(s->block_table + n_blocks);
+  s->evolution_offsets = evolution_offsets.data();
+  s->matrix_data = reinterpret_cast<h_scalar_t*>(p + header_size);
+  s->matrix_capacity = matrix_capacity;
+  s->buffer = std::move(buf);
+ }
+};
+}
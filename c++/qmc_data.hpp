@@ -20,9 +20,11 @@
  ******************************************************************************/
 #pragma once
 #include "impurity_trace.hpp"
+#include "sliding_window.hpp"
 #include <triqs/gfs.hpp>
 #include <triqs/det_manip.hpp>
 #include <triqs/utility/serialization.hpp>
+#include <memory>
 
 namespace cthyb {
 using namespace triqs::gfs;
@@ -34,54 +36,132 @@ struct qmc_data {
 
  configuration config; // Configuration
  time_segment tau_seg;
+ sliding_window window; // time window of the insertions and removals
  std::map<std::pair<int, int>, int> linindex; // Linear index constructed from block and inner indices
  atom_diag const &h_diag;                     // Diagonalization of the atomic problem
  mutable impurity_trace imp_trace;            // Calculator of the trace
  std::vector<int> n_inner;
 
  /// This callable object adapts the Delta function for the call of the det.
+ /// Delta is tabulated contiguously for each pair of inner indices, and taken at the closest mesh point, or linearly
+ /// interpolated between the two closest ones. The copies of an adaptor share its table.
  struct delta_block_adaptor {
-  gf<imtime, delta_target_t> delta_block; // make a copy. Needed in the real case anyway.
+  int n_tau, dim;
+  double tau_to_index;                                    // (n_tau - 1) / beta
+  bool linear;                                            // interpolate linearly, or take the closest mesh point
+  std::shared_ptr<const std::vector<det_scalar_t>> table; // Delta(tau_k)(i, j) at (i * dim + j) * n_tau + k
 
-  delta_block_adaptor(gf<imtime, delta_target_t> delta_block) : delta_block(std::move(delta_block)) {}
+  delta_block_adaptor(gf_const_view<imtime, delta_target_t> delta_block, bool linear)
+     : n_tau(delta_block.mesh().size()),
+       dim(delta_block.data().shape()[1]),
+       tau_to_index((n_tau - 1) / delta_block.mesh().domain().beta),
+       linear(linear) {
+   auto const &d = delta_block.data();
+   auto t = std::make_shared<std::vector<det_scalar_t>>(long(dim) * dim * n_tau);
+   for (int i = 0; i < dim; ++i)
+    for (int j = 0; j < dim; ++j)
+     for (int k = 0; k < n_tau; ++k) (*t)[(i * dim + j) * long(n_tau) + k] = d(k, i, j);
+   table = std::move(t);
+  }
   delta_block_adaptor(delta_block_adaptor const &) = default;
   delta_block_adaptor(delta_block_adaptor &&) = default;
   delta_block_adaptor &operator=(delta_block_adaptor const &) = delete; // forbid assignment
   delta_block_adaptor &operator=(delta_block_adaptor &&a) = default;
 
   det_scalar_t operator()(std::pair<time_pt, int> const &x, std::pair<time_pt, int> const &y) const {
-   det_scalar_t res = delta_block[closest_mesh_pt(double(x.first - y.first))](x.second, y.second);
+   double s = double(x.first - y.first) * tau_to_index; // in [0, n_tau - 1]
+   det_scalar_t const *t = table->data() + (x.second * dim + y.second) * long(n_tau);
+   det_scalar_t res;
+   if (linear) {
+    int k = std::min(int(s), n_tau - 2);
+    res = t[k] + (s - k) * (t[k + 1] - t[k]);
+   } else
+    res = t[int(s + 0.5)];
    return (x.first >= y.first ? res : -res); // x,y first are time_pt, wrapping is automatic in the - operation, but need to
                                              // compute the sign
   }
  };
 
+ /// Delta(tau) of all the blocks, tabulated once for all the Markov chains of the node
+ static std::vector<delta_block_adaptor> make_delta_adaptors(block_gf_const_view<imtime> delta, solve_parameters_t const &p) {
+  if (p.delta_interpolation != "nearest" && p.delta_interpolation != "linear")
+   TRIQS_RUNTIME_ERROR << "delta_interpolation must be \"nearest\" or \"linear\", not \"" << p.delta_interpolation << "\"";
+  bool linear = (p.delta_interpolation == "linear");
+  std::vector<delta_block_adaptor> r;
+  for (int bl = 0; bl < delta.mesh().size(); ++bl) {
+#ifdef HYBRIDISATION_IS_COMPLEX
+   r.emplace_back(delta[bl], linear);
+#else
+   if (!is_gf_real(delta[bl], 1e-10)) TRIQS_RUNTIME_ERROR << "The Delta(tau) block number " << bl << " is not real in tau space";
+   r.emplace_back(real(delta[bl]), linear);
+#endif
+  }
+  return r;
+ }
+
  std::vector<det_manip::det_manip<delta_block_adaptor>> dets; // The determinants
  int current_sign, old_sign;                                  // Permutation prefactor
  h_scalar_t atomic_weight;                                    // The current value of the trace or norm
  h_scalar_t atomic_reweighting;                               // The current value of the reweighting
+ mc_weight_t initial_sign = 1; // Sign of the starting configuration. The sign given to the measures is relative to it.
 
  // Construction
  qmc_data(double beta, solve_parameters_t const &p, atom_diag const &h_diag, std::map<std::pair<int, int>, int> linindex,
-          block_gf_const_view<imtime> delta, std::vector<int> n_inner, histo_map_t * histo_map)
+          std::vector<delta_block_adaptor> const &deltas, std::vector<int> n_inner, histo_map_t * histo_map,
+          configuration_data_t const &initial_config = configuration_data_t{})
     : config(beta),
       tau_seg(beta),
+      window(beta, tau_seg, p.n_move_windows),
       h_diag(h_diag),
       linindex(linindex),
-      imp_trace(config, h_diag, p, histo_map),
+      imp_trace(config, h_diag, p, histo_map, &window),
       current_sign(1),
       old_sign(1),
       n_inner(n_inner) {
+
+  // The starting configuration: the operators of initial_config (none by default), with their times rescaled if the
+  // configuration was obtained at another beta. The operators are sorted by decreasing time for the dets.
+  int n_blocks = deltas.size();
+  std::vector<std::vector<std::pair<time_pt, int>>> x(n_blocks), y(n_blocks); // c^dagger and c of each block
+  for (int k = 0; k < initial_config.size(); ++k) {
+   int b = initial_config.block_index[k], i = initial_config.inner_index[k];
+   if ((b < 0) || (b >= n_blocks) || (i < 0) || (i >= this->n_inner[b]))
+    TRIQS_RUNTIME_ERROR << "The initial configuration does not match the block structure of Delta";
+   auto tau = tau_seg.make_time_pt(initial_config.tau[k] * beta / initial_config.beta);
+   auto op = op_desc{b, i, bool(initial_config.dagger[k]), this->linindex[std::make_pair(b, i)]};
+   config.insert(tau, op);
+   imp_trace.try_insert(tau, op);
+   imp_trace.confirm_insert();
+   (op.dagger ? x : y)[b].push_back({tau, i});
+  }
+  auto later = [](std::pair<time_pt, int> const &a, std::pair<time_pt, int> const &b) { return a.first > b.first; };
+  for (int b = 0; b < n_blocks; ++b) {
+   if (x[b].size() != y[b].size()) TRIQS_RUNTIME_ERROR << "The initial configuration has unpaired operators in block " << b;
+   std::sort(x[b].begin(), x[b].end(), later);
+   std::sort(y[b].begin(), y[b].end(), later);
+  }
+
   std::tie(atomic_weight, atomic_reweighting) = imp_trace.compute();
+  imp_trace.commit_density_matrix();
   dets.clear();
-  for (auto const &bl : delta.mesh()) {
-#ifdef HYBRIDISATION_IS_COMPLEX
-   dets.emplace_back(delta_block_adaptor(delta[bl]), 100);
-#else
-   if (!is_gf_real(delta[bl], 1e-10)) TRIQS_RUNTIME_ERROR << "The Delta(tau) block number " << bl << " is not real in tau space";
-   dets.emplace_back(delta_block_adaptor(real(delta[bl])), 100);
-#endif
+  for (int bl = 0; bl < n_blocks; ++bl) {
+   if (x[bl].empty())
+    dets.emplace_back(deltas[bl], 100);
+   else
+    dets.emplace_back(deltas[bl], x[bl], y[bl]);
   }
+
+  update_sign();
+  old_sign = current_sign;
+  initial_sign = weight_phase();
+  if (initial_sign == mc_weight_t(0)) TRIQS_RUNTIME_ERROR << "The weight of the initial configuration is zero";
+ }
+
+ /// The phase of the Monte Carlo weight of the current configuration (the sign in the real case), 0 if the weight is 0
+ mc_weight_t weight_phase() const {
+  mc_weight_t w = current_sign * atomic_weight;
+  for (auto const &d : dets) w *= d.determinant();
+  return (w == mc_weight_t(0) ? w : w / std::abs(w));
  }
 
  qmc_data(qmc_data const &) = default;
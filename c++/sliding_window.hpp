@@ -0,0 +1,104 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <triqs/utility/exceptions.hpp>
+#include <triqs/utility/time_pt.hpp>
+#include "./det_positions.hpp"
+#include <utility>
+
+namespace cthyb {
+
+using triqs::utility::time_pt;
+using triqs::utility::time_segment;
+
+/********************************************
+ The imaginary time window of the insertion and removal moves.
+
+ The window has a width beta / n_move_windows. It is moved by half its width,
+ sweeping back and forth across [0, beta[. With n_move_windows = 1, it is
+ the whole [0, beta[ and never moves.
+ The moves satisfy detailed balance for a fixed window, hence moving the
+ window between two moves leaves the distribution invariant.
+ With trace_method = "window", impurity_trace caches the products of the
+ operators outside the window, so that a move in the window only recomputes
+ the product of the operators inside it.
+ The bounds are points of the time grid of tau_seg, so that the random times
+ are drawn directly in the window.
+ ********************************************/
+class sliding_window {
+
+ time_segment tau_seg;
+ double beta, width_;
+ int n_positions, position = 0, direction = 1;
+ time_pt lower, upper; // the window is [lower, upper[
+
+ public:
+ sliding_window(double beta, time_segment const& tau_seg, int n_move_windows)
+    : tau_seg(tau_seg), beta(beta), width_(beta / n_move_windows), n_positions(2 * n_move_windows - 1) {
+  if (n_move_windows < 1) TRIQS_RUNTIME_ERROR << "The number of time windows must be >= 1, not " << n_move_windows;
+  set_bounds();
+ }
+
+ /// Is the window the whole [0, beta[ ?
+ bool is_full() const { return n_positions == 1; }
+
+ /// The window is [get_lower(), get_upper()[
+ time_pt const& get_lower() const { return lower; }
+ time_pt const& get_upper() const { return upper; }
+
+ /// Width of the window
+ double width() const { return (is_full() ? beta : double(upper - lower)); }
+
+ /// Is tau in the window ?
+ bool contains(time_pt const& tau) const { return is_full() || ((tau >= lower) && (tau < upper)); }
+
+ /// A random time in the window, drawn uniformly on the points of the time grid in [lower, upper[
+ template <typename RNG> time_pt get_random_pt(RNG& rng) const {
+  if (is_full()) return tau_seg.get_random_pt(rng);
+  return lower + tau_seg.get_random_pt(rng, upper - lower);
+ }
+
+ /// The operators of det in the window, for the c^dagger (x) or the c (y) : {position of the first one, number}
+ /// The det stores the operators in decreasing time order, so they are contiguous and found by bisection.
+ template <typename Det> std::pair<int, int> find_in_window(Det const& det, bool dagger) const {
+  int det_size = det.size();
+  if (is_full()) return {0, det_size};
+  int first = det_partition_point(det, dagger, [this](time_pt const& t) { return t < upper; });
+  int last = det_partition_point(det, dagger, [this](time_pt const& t) { return t < lower; });
+  return {first, last - first};
+ }
+
+ /// Move the window to its next position
+ void slide() {
+  if (is_full()) return;
+  if ((position + direction < 0) || (position + direction >= n_positions)) direction = -direction;
+  position += direction;
+  set_bounds();
+ }
+
+ private:
+ // The last position ends exactly at the upper point of the grid
+ void set_bounds() {
+  lower = tau_seg.make_time_pt(position * width_ / 2);
+  upper = (position == n_positions - 1 ? tau_seg.get_upper_pt() : tau_seg.make_time_pt(position * width_ / 2 + width_));
+ }
+};
+}
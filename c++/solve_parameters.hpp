@@ -19,19 +19,37 @@ struct solve_parameters_t {
  /// type: str
  std::string partition_method = "autopartition";
 
+ /// Drop atomic eigenstates with an energy above the ground state larger than this
+ /// default: -1 = keep all
+ double energy_cutoff = -1;
+
+ /// Drop atomic eigenstates with a Boltzmann weight exp(-beta*E) below this
+ /// default: 0 = keep all
+ double boltzmann_cutoff = 0;
+
  /// Quantum numbers
  /// type: list(Operator)
  /// default: []
  std::vector<many_body_op_t> quantum_numbers = std::vector<many_body_op_t>{};
 
+ /// Directory of the cache of the diagonalizations of h_loc (empty: no cache)
+ /// type: str
+ std::string atom_diag_cache = "";
+
  /// Length of a single QMC cycle
  /// default: 50
  int length_cycle = 50;
 
+ /// Set length_cycle from the autocorrelation times measured during warmup?
+ bool auto_length_cycle = false;
+
  /// Number of cycles for thermalization
  /// default: 5000
  int n_warmup_cycles = 5000;
 
+ /// Start from the last configuration of the previous solve (shorter warmup)?
+ bool warm_start = false;
+
  /// Seed for random number generator
  /// default: 34788 + 928374 * MPI.rank
  int random_seed = 34788 + 928374 * triqs::mpi::communicator().rank();
@@ -44,6 +62,22 @@ struct solve_parameters_t {
  /// default: -1 = infinite
  int max_time = -1;
 
+ /// Stop when the error of target_observable is below this (n_cycles: maximum)
+ /// default: -1 = off
+ double target_error = -1;
+
+ /// Observable for target_error: "average_sign", "G_tau" or "G_l" (largest error)
+ /// type: str
+ std::string target_observable = "average_sign";
+
+ /// Checkpoints <checkpoint_file>_<rank>.h5, to resume an interrupted accumulation
+ /// type: str
+ std::string checkpoint_file = "";
+
+ /// Seconds between two checkpoints during the accumulation
+ /// default: 600
+ int checkpoint_interval = 600;
+
  /// Verbosity level
  /// default: 3 on MPI rank 0, 0 otherwise.
  int verbosity = ((triqs::mpi::communicator().rank() == 0) ? 3 : 0); // silence the slave nodes
@@ -54,6 +88,15 @@ struct solve_parameters_t {
  /// Add double insertions as a move?
  bool move_double = false;
 
+ /// Insert/remove only in a sliding window of width beta/n_move_windows
+ /// default: 1
+ int n_move_windows = 1;
+
+ /// Trace evaluation: "rb_tree", or "window" (products outside the window cached)
+ /// type: str
+ /// default: "rb_tree"
+ std::string trace_method = "rb_tree";
+
  /// Calculate the full trace or use an estimate?
  bool use_trace_estimator = false;
 
@@ -63,6 +106,27 @@ struct solve_parameters_t {
  /// Measure G_l (Legendre)?
  bool measure_g_l = false;
 
+ /// Measure G(iw) directly in Matsubara frequencies?
+ bool measure_g_iw = false;
+
+ /// Measure F(tau) = -<[c, h_int](tau) c^dagger> (improved estimator of Sigma)?
+ bool measure_f_tau = false;
+
+ /// Measure the two-particle Green's function G2(iW, iw, iw')?
+ bool measure_g2 = false;
+
+ /// Number of fermionic frequencies of G2 on each side of 0
+ /// default: 10
+ int g2_n_fermionic = 10;
+
+ /// Number of bosonic frequencies of G2, from 0
+ /// default: 1
+ int g2_n_bosonic = 1;
+
+ /// Number of threads assembling G2 in each measure
+ /// default: 1
+ int n_g2_threads = 1;
+
  /// Measure perturbation order?
  bool measure_pert_order = false;
 
@@ -75,6 +139,18 @@ struct solve_parameters_t {
  /// Analyse performance of trace computation with histograms (developers only)?
  bool performance_analysis = false;
 
+ /// Number of threads computing the blocks of the trace in parallel
+ /// default: 1
+ int n_trace_threads = 1;
+
+ /// Number of threads diagonalizing the blocks of the local Hamiltonian
+ /// default: 1
+ int n_diag_threads = 1;
+
+ /// Number of independent Markov chains run in parallel threads on each node
+ /// default: 1
+ int n_chains = 1;
+
  /// Operator insertion/removal probabilities for different blocks
  /// type: dict(str:float)
  /// default: {}
@@ -83,6 +159,10 @@ struct solve_parameters_t {
  /// Threshold below which imaginary components of Delta and h_loc are set to zero
  double imag_threshold = 1.e-15;
 
+ /// Interpolation of Delta(tau) between the mesh points: "nearest" or "linear"
+ /// type: str
+ std::string delta_interpolation = "nearest";
+
  solve_parameters_t() {}
 
  solve_parameters_t(many_body_op_t h_int, int n_cycles) : h_int(h_int), n_cycles(n_cycles) {}
@@ -20,22 +20,42 @@
  ******************************************************************************/
 #include "./solver_core.hpp"
 #include "./qmc_data.hpp"
+#include "./atom_diag_cache.hpp"
 #include <triqs/utility/callbacks.hpp>
+#include <triqs/utility/signal_handler.hpp>
 #include <triqs/utility/exceptions.hpp>
 #include <triqs/utility/variant_int_string.hpp>
 #include <triqs/gfs.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
 
 #include "move_insert.hpp"
 #include "move_remove.hpp"
 #include "move_double_insert.hpp"
 #include "move_double_remove.hpp"
 #include "move_shift.hpp"
+#include "move_slide_window.hpp"
 #include "measure_g.hpp"
 #include "measure_g_legendre.hpp"
+#include "measure_g_iw.hpp"
+#include "measure_f_tau.hpp"
+#include "measure_g2.hpp"
 #include "measure_perturbation_hist.hpp"
 #include "measure_density_matrix.hpp"
 #include "measure_average_sign.hpp"
+#include "measure_autocorrelation.hpp"
+#include "measure_weight_sums.hpp"
+#include "batch_error.hpp"
+#include "thread_pool.hpp"
 
 namespace cthyb {
 
@@ -45,6 +65,314 @@ struct index_visitor  {
   void operator()(std::string s) { indices.push_back(s); }
 };
 
+// The file of the configuration of a node (checkpoints, warm starts): <prefix>_<rank>.h5
+static std::string node_file_name(std::string const& prefix, int rank) { return prefix + "_" + std::to_string(rank) + ".h5"; }
+
+static configuration_data_t read_configuration_file(std::string const& name) {
+  configuration_data_t c;
+  triqs::h5::file f(name.c_str(), H5F_ACC_RDONLY);
+  h5_read(f, "configuration", c);
+  return c;
+}
+
+// Written with write(group) in a temporary file first, so that the file is never left incomplete
+template <typename F> static void write_file(std::string const& name, F write) {
+  {
+   triqs::h5::file f((name + ".tmp").c_str(), H5F_ACC_TRUNC);
+   write(triqs::h5::group(f));
+  }
+  if (std::rename((name + ".tmp").c_str(), name.c_str()) != 0) TRIQS_RUNTIME_ERROR << "Cannot write the file " << name;
+}
+
+static void write_configuration_file(std::string const& name, configuration_data_t const& c) {
+  write_file(name, [&c](triqs::h5::group g) { h5_write(g, "configuration", c); });
+}
+
+// h5_read into a (view of an) array, which must have the shape of the saved one
+template <typename A> static void h5_read_into(triqs::h5::group g, std::string const& name, A&& a) {
+  typename std::decay_t<A>::regular_type r;
+  h5_read(g, name, r);
+  if (r.shape() != a.shape()) TRIQS_RUNTIME_ERROR << "The shape of " << name << " in the checkpoint does not match";
+  a = r;
+}
+
+// Can the run restart from the checkpoint file name ? It must exist, be for the same problem and not be completed.
+static bool can_restart_from(std::string const& name, std::string const& problem_key) {
+  if (!std::ifstream(name).good()) return false;
+  triqs::h5::file f(name.c_str(), H5F_ACC_RDONLY);
+  triqs::h5::group g(f);
+  if (!g.has_key("problem_key") || !g.has_key("sums")) return false;
+  std::string key;
+  int completed = 0;
+  h5_read(g, "problem_key", key);
+  h5_read(g, "completed", completed);
+  return (key == problem_key) && !completed;
+}
+
+// The key of the problem for the checkpoints: FNV-1a hash of beta, h_loc and Delta(tau), and of the description of
+// the measures (which ones, on which meshes), since the checkpoints have their partial sums
+static std::string problem_key(double beta, many_body_op_t const& h_loc, block_gf_const_view<imtime> delta,
+                               std::string const& measures) {
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](std::string const& s) {
+   for (unsigned char c : s) hash = (hash ^ c) * 1099511628211ull;
+  };
+  std::ostringstream os;
+  os << std::setprecision(17) << beta << "\n" << h_loc << "\n" << measures << "\n";
+  for (int b = 0; b < delta.mesh().size(); ++b) {
+   auto const& d = delta[b].data();
+   for (int t = 0; t < d.shape()[0]; ++t)
+    for (int i = 0; i < d.shape()[1]; ++i)
+     for (int j = 0; j < d.shape()[2]; ++j) os << d(t, i, j) << " ";
+  }
+  add(os.str());
+  std::ostringstream r;
+  r << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return r.str();
+}
+
+// A Markov chain of the node: its own configuration, trace and determinants, random number generator and accumulators
+struct markov_chain {
+  std::unique_ptr<qmc_data> data;
+  mc_tools::mc_generic<mc_weight_t> qmc;
+  block_gf<imtime, g_target_t> G_tau_accum;
+  block_gf<legendre> G_l;
+  block_gf<imfreq> G_iw;
+  std::vector<arrays::array<dcomplex, 3>> G_iw_grids; // the sums of measure_g_iw, for each block
+  block_gf<imtime, g_target_t> F_tau_accum;
+  std::vector<arrays::array<dcomplex, 7>> G2_iw;
+  histogram pert_order_total;
+  histo_map_t pert_order;
+  std::vector<matrix_t> density_matrix;
+  mc_weight_t average_sign;
+  weight_sums_t weight_sums;
+
+  markov_chain(std::unique_ptr<qmc_data> data, std::string const& random_name, int random_seed, int verbosity)
+     : data(std::move(data)), qmc(random_name, random_seed, 1.0, verbosity) {}
+
+  // The partial sums of the measures of params, before collect_results, with the weight sums (signed_sum, abs_sum,
+  // num), for the checkpoints. They are read once all the measures are added, since the measures reset them.
+  void write_sums(triqs::h5::group g, solve_parameters_t const& params) const {
+   auto name = [](std::string const& s, int i) { return s + "_" + std::to_string(i); };
+   arrays::array<mc_weight_t, 1> signed_sum(1); // the signed sum as an array, complex or not
+   signed_sum(0) = weight_sums.signed_sum;
+   h5_write(g, "signed_sum", signed_sum);
+   h5_write(g, "abs_sum", weight_sums.abs_sum);
+   h5_write(g, "num", long(weight_sums.num));
+   if (params.measure_g_tau)
+    for (size_t b = 0; b < G_tau_accum.domain().size(); ++b) h5_write(g, name("G_tau", b), G_tau_accum[b].data());
+   if (params.measure_g_l)
+    for (size_t b = 0; b < G_l.domain().size(); ++b) h5_write(g, name("G_l", b), G_l[b].data());
+   if (params.measure_g_iw)
+    for (size_t b = 0; b < G_iw_grids.size(); ++b) h5_write(g, name("G_iw_grid", b), G_iw_grids[b]);
+   if (params.measure_f_tau)
+    for (size_t b = 0; b < F_tau_accum.domain().size(); ++b) h5_write(g, name("F_tau", b), F_tau_accum[b].data());
+   if (params.measure_g2)
+    for (size_t i = 0; i < G2_iw.size(); ++i) h5_write(g, name("G2_iw", i), G2_iw[i]);
+   if (params.measure_density_matrix)
+    for (size_t b = 0; b < density_matrix.size(); ++b) h5_write(g, name("density_matrix", b), density_matrix[b]);
+   if (params.measure_pert_order) {
+    h5_write(g, "pert_order_total", pert_order_total);
+    for (auto const& h : pert_order) h5_write(g, "pert_order_" + h.first, h.second);
+   }
+  }
+
+  void read_sums(triqs::h5::group g, solve_parameters_t const& params) {
+   auto name = [](std::string const& s, int i) { return s + "_" + std::to_string(i); };
+   weight_sums = read_weight_sums(g);
+   if (params.measure_g_tau)
+    for (size_t b = 0; b < G_tau_accum.domain().size(); ++b) h5_read_into(g, name("G_tau", b), G_tau_accum[b].data());
+   if (params.measure_g_l)
+    for (size_t b = 0; b < G_l.domain().size(); ++b) h5_read_into(g, name("G_l", b), G_l[b].data());
+   if (params.measure_g_iw)
+    for (size_t b = 0; b < G_iw_grids.size(); ++b) h5_read_into(g, name("G_iw_grid", b), G_iw_grids[b]);
+   if (params.measure_f_tau)
+    for (size_t b = 0; b < F_tau_accum.domain().size(); ++b) h5_read_into(g, name("F_tau", b), F_tau_accum[b].data());
+   if (params.measure_g2)
+    for (size_t i = 0; i < G2_iw.size(); ++i) h5_read_into(g, name("G2_iw", i), G2_iw[i]);
+   if (params.measure_density_matrix)
+    for (size_t b = 0; b < density_matrix.size(); ++b) h5_read_into(g, name("density_matrix", b), density_matrix[b]);
+   if (params.measure_pert_order) {
+    h5_read(g, "pert_order_total", pert_order_total);
+    for (auto& h : pert_order) h5_read(g, "pert_order_" + h.first, h.second);
+   }
+  }
+
+  static weight_sums_t read_weight_sums(triqs::h5::group g) {
+   arrays::array<mc_weight_t, 1> signed_sum;
+   long num = 0;
+   weight_sums_t r;
+   h5_read(g, "signed_sum", signed_sum);
+   h5_read(g, "abs_sum", r.abs_sum);
+   h5_read(g, "num", num);
+   r.signed_sum = signed_sum(0);
+   r.num = num;
+   return r;
+  }
+};
+
+// A checkpoint of the chain: its configuration and the partial sums of its measures, the number of the run segment
+// (0 for the first run, one more at each restart) and the length of the cycle, the key of the problem it was made for,
+// and if the accumulation was completed
+static void write_checkpoint_file(std::string const& name, markov_chain const& chain, solve_parameters_t const& params,
+                                  std::string const& problem_key, int segment, int length_cycle, bool completed) {
+  write_file(name, [&](triqs::h5::group g) {
+   h5_write(g, "configuration", chain.data->config.get_data());
+   h5_write(g, "problem_key", problem_key);
+   h5_write(g, "completed", int(completed));
+   h5_write(g, "segment", segment);
+   h5_write(g, "length_cycle", length_cycle);
+   chain.write_sums(g.create_group("sums"), params);
+  });
+}
+
+// A measure resuming the accumulation of a checkpoint: its normalization starts from the weight sums of the cycles
+// already done, as its partial sums
+template <typename M> static M resumed(M m, weight_sums_t const& done) {
+  m.z = done.signed_sum;
+  m.num = done.num;
+  return m;
+}
+static measure_density_matrix resumed(measure_density_matrix m, weight_sums_t const& done) {
+  m.z = done.signed_sum;
+  return m;
+}
+static measure_average_sign resumed(measure_average_sign m, weight_sums_t const& done) {
+  m.sign = done.signed_sum;
+  m.z = done.abs_sum;
+  return m;
+}
+
+// mc_generic::run (hence warmup and accumulate) starts the process-wide triqs::signal_handler, reads it after each
+// cycle and stops it (clearing its state) when it returns. This static state is not protected, so the chains running
+// in threads must not stop it while another one may read it. The chains of a run (warmup or accumulation) therefore
+// leave mc_generic::run one at a time, in order, once all of them have reached their last cycle: a chain waits in
+// its stop callback at its last cycle (the n-th call, or when the time is over or a signal was received) until its
+// turn, and the next turn comes when the previous chain has returned from mc_generic. The handler is started by the
+// calling thread before the run, so that the chains only read it when they start it again.
+// A signal arriving between the check in the stop callback and the one of mc_generic is still seen unsynchronized
+// by that chain, as a signal is by a single chain.
+class chain_exit_order {
+
+ public:
+ // The inactive chains do not run: they are done from the start
+ chain_exit_order(std::vector<bool> const& active) : done(active.size()), waiting(active.size()) {
+  for (size_t c = 0; c < active.size(); ++c) done[c] = waiting[c] = !active[c];
+  n_waiting = std::count(waiting.begin(), waiting.end(), true);
+ }
+
+ // The stop callback of the chain c for a run of n_cycles cycles
+ std::function<bool()> stop_callback(int c, long n_cycles, std::function<bool()> const& stop) {
+  long n_calls = 0;
+  return [this, c, n_cycles, stop, n_calls]() mutable {
+   bool last = (++n_calls >= n_cycles) || stop() || triqs::signal_handler::received();
+   if (last) wait_turn(c);
+   return last;
+  };
+ }
+
+ // Called when the chain c has returned from mc_generic::run, also by an exception
+ void leave(int c) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!waiting[c]) ++n_waiting;
+  waiting[c] = true;
+  done[c] = true;
+  changed.notify_all();
+ }
+
+ private:
+ std::mutex mutex;
+ std::condition_variable changed;
+ std::vector<bool> done, waiting; // returned from mc_generic::run, at the last cycle or done
+ long n_waiting;                   // number of waiting chains
+
+ void wait_turn(int c) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!waiting[c]) ++n_waiting;
+  waiting[c] = true;
+  changed.notify_all();
+  changed.wait(lock, [this, c]() {
+   return (n_waiting == long(done.size())) && (std::find(done.begin(), done.end(), false) - done.begin() == c);
+  });
+ }
+};
+
+// x <- a * x. A chain without any measure has x = 0/0: it is replaced by 0.
+template <typename A> static void scale(A& x, double a) {
+  if (a == 0)
+   x() = 0;
+  else
+   x *= a;
+}
+static void scale(mc_weight_t& x, double a) { x = (a == 0 ? mc_weight_t(0) : a * x); }
+
+// Combines the results of the chains of all the nodes in chains[0]. The results of each chain are normalized by its sums
+// of weights: their average weighted by these sums is the same as the normalization of the sums of the measures of all
+// the chains together, as done by collect_results for the nodes. The histograms are added.
+static void combine_chains(std::vector<std::unique_ptr<markov_chain>> const& chains, solve_parameters_t const& params,
+                           triqs::mpi::communicator const& comm) {
+  std::vector<double> w, w_abs; // weights of G, G_l and the density matrix, and of the average sign
+  for (auto const& chain : chains) {
+   w.push_back(std::real(chain->weight_sums.signed_sum));
+   w_abs.push_back(chain->weight_sums.abs_sum);
+  }
+  double w_total = mpi_all_reduce(std::accumulate(w.begin(), w.end(), 0.0), comm);
+  double w_abs_total = mpi_all_reduce(std::accumulate(w_abs.begin(), w_abs.end(), 0.0), comm);
+
+  // sum_c w[c] x_c / sum_c w[c] on all nodes, in x_0 = get(*chains[0])
+  auto average = [&chains, &comm](std::vector<double> const& w, double w_total, auto get) {
+   auto& x = get(*chains[0]);
+   scale(x, w[0]);
+   for (size_t c = 1; c < chains.size(); ++c) {
+    auto y = get(*chains[c]);
+    scale(y, w[c]);
+    x += y;
+   }
+   x = mpi_all_reduce(x, comm);
+   scale(x, 1 / w_total);
+  };
+
+  auto& r = *chains[0];
+  if (params.measure_g_tau)
+   for (size_t b = 0; b < r.G_tau_accum.domain().size(); ++b)
+    average(w, w_total, [b](markov_chain& c) -> auto& { return c.G_tau_accum[b].data(); });
+  if (params.measure_f_tau)
+   for (size_t b = 0; b < r.F_tau_accum.domain().size(); ++b) {
+    average(w, w_total, [b](markov_chain& c) -> auto& { return c.F_tau_accum[b].data(); });
+    measure_f_tau::set_tail(r.F_tau_accum[b]);
+   }
+  if (params.measure_g_l)
+   for (size_t b = 0; b < r.G_l.domain().size(); ++b)
+    average(w, w_total, [b](markov_chain& c) -> auto& { return c.G_l[b].data(); });
+  if (params.measure_g_iw)
+   for (size_t b = 0; b < r.G_iw.domain().size(); ++b)
+    average(w, w_total, [b](markov_chain& c) -> auto& { return c.G_iw[b].data(); });
+  if (params.measure_g2)
+   for (size_t i = 0; i < r.G2_iw.size(); ++i)
+    average(w, w_total, [i](markov_chain& c) -> auto& { return c.G2_iw[i]; });
+  if (params.measure_density_matrix)
+   for (size_t b = 0; b < r.density_matrix.size(); ++b)
+    average(w, w_total, [b](markov_chain& c) -> auto& { return c.density_matrix[b]; });
+  average(w_abs, w_abs_total, [](markov_chain& c) -> auto& { return c.average_sign; });
+
+  if (params.measure_pert_order) {
+   for (size_t c = 1; c < chains.size(); ++c) {
+    r.pert_order_total = r.pert_order_total + chains[c]->pert_order_total;
+    for (auto& h : r.pert_order) h.second = h.second + chains[c]->pert_order[h.first];
+   }
+   r.pert_order_total = mpi_all_reduce(r.pert_order_total, comm);
+   for (auto& h : r.pert_order) h.second = mpi_all_reduce(h.second, comm);
+  }
+}
+
+void solver_core::save_last_configuration(std::string const& prefix) const {
+  write_configuration_file(node_file_name(prefix, _comm.rank()), _last_configuration);
+}
+
+void solver_core::load_last_configuration(std::string const& prefix) {
+  _last_configuration = read_configuration_file(node_file_name(prefix, _comm.rank()));
+}
+
 solver_core::solver_core(double beta_, std::map<std::string, indices_type> const & gf_struct_, int n_iw, int n_tau, int n_l):
   beta(beta_), gf_struct(gf_struct_) {
 
@@ -54,6 +382,7 @@ solver_core::solver_core(double beta_, std::map<std::string, indices_type> const
   std::vector<gf<imfreq>> g0_iw_blocks;
   std::vector<gf<imtime>> g_tau_blocks;
   std::vector<gf<legendre>> g_l_blocks;
+  std::vector<gf<imfreq>> g_iw_blocks;
   std::vector<gf<imtime>> delta_tau_blocks;
   std::vector<gf<imtime, delta_target_t>> g_tau_accum_blocks; //  Local real or complex (if complex mode) quantities for accumulation
 
@@ -68,6 +397,7 @@ solver_core::solver_core(double beta_, std::map<std::string, indices_type> const
     g0_iw_blocks.push_back(gf<imfreq>{{beta, Fermion, n_iw}, {n, n}, indices});
     g_tau_blocks.push_back(gf<imtime>{{beta, Fermion, n_tau}, {n, n}, indices});
     g_l_blocks.push_back(gf<legendre>{{beta, Fermion, static_cast<size_t>(n_l)}, {n,n}, indices}); // FIXME: cast is ugly
+    g_iw_blocks.push_back(gf<imfreq>{{beta, Fermion, n_iw}, {n, n}, indices});
     delta_tau_blocks.push_back(gf<imtime>{{beta, Fermion, n_tau}, {n, n}, indices});
     g_tau_accum_blocks.push_back(gf<imtime, delta_target_t>{{beta, Fermion, n_tau}, {n, n}});
   }
@@ -75,8 +405,11 @@ solver_core::solver_core(double beta_, std::map<std::string, indices_type> const
   _G0_iw = make_block_gf(block_names, g0_iw_blocks);
   _G_tau = make_block_gf(block_names, g_tau_blocks);
   _G_l = make_block_gf(block_names, g_l_blocks);
+  _G_iw_measured = make_block_gf(block_names, g_iw_blocks);
   _Delta_tau = make_block_gf(block_names, delta_tau_blocks);
   _G_tau_accum = make_block_gf(block_names, g_tau_accum_blocks);
+  _F_tau = _G_tau;
+  _F_tau_accum = _G_tau_accum;
 
 }
 
@@ -167,19 +500,33 @@ void solver_core::solve(solve_parameters_t const & params) {
   _performance_analysis.clear();
   histo_map_t * histo_map = params.performance_analysis ? &_performance_analysis : nullptr;
 
+  // The diagonalization from the cache, if the same h_loc has been diagonalized before in the same way
+  std::string cache_key;
+  bool cache_hit = false;
+  if (!params.atom_diag_cache.empty()) {
+   cache_key = atom_diag_cache::make_key(_h_loc, fops, params.partition_method, params.quantum_numbers);
+   cache_hit = atom_diag_cache(params.atom_diag_cache).load(cache_key, _h_loc, h_diag);
+   if (params.verbosity >= 2)
+    std::cout << (cache_hit ? "Diagonalization of the local Hamiltonian found in the cache"
+                            : "Diagonalization of the local Hamiltonian not in the cache") << std::endl;
+  }
+
   // Determine block structure
-  if (params.partition_method == "autopartition") {
-   if (params.verbosity >= 2) std::cout << "Using autopartition algorithm to partition the local Hilbert space" << std::endl;
-   h_diag = {_h_loc, fops};
-  } else if (params.partition_method == "quantum_numbers") {
-   if (params.quantum_numbers.empty()) TRIQS_RUNTIME_ERROR << "No quantum numbers provided.";
-   if (params.verbosity >= 2) std::cout << "Using quantum numbers to partition the local Hilbert space" << std::endl;
-   h_diag = {_h_loc, fops, params.quantum_numbers};
-  } else if (params.partition_method == "none") { // give empty quantum numbers list
-   std::cout << "Not partitioning the local Hilbert space" << std::endl;
-   h_diag = {_h_loc, fops, std::vector<many_body_op_t>{}};
-  } else
-   TRIQS_RUNTIME_ERROR << "Partition method " << params.partition_method << " not recognised.";
+  if (!cache_hit) {
+   if (params.partition_method == "autopartition") {
+    if (params.verbosity >= 2) std::cout << "Using autopartition algorithm to partition the local Hilbert space" << std::endl;
+    h_diag = {_h_loc, fops, params.n_diag_threads};
+   } else if (params.partition_method == "quantum_numbers") {
+    if (params.quantum_numbers.empty()) TRIQS_RUNTIME_ERROR << "No quantum numbers provided.";
+    if (params.verbosity >= 2) std::cout << "Using quantum numbers to partition the local Hilbert space" << std::endl;
+    h_diag = {_h_loc, fops, params.quantum_numbers, params.n_diag_threads};
+   } else if (params.partition_method == "none") { // give empty quantum numbers list
+    std::cout << "Not partitioning the local Hilbert space" << std::endl;
+    h_diag = {_h_loc, fops, std::vector<many_body_op_t>{}, params.n_diag_threads};
+   } else
+    TRIQS_RUNTIME_ERROR << "Partition method " << params.partition_method << " not recognised.";
+   if (!cache_key.empty() && (_comm.rank() == 0)) atom_diag_cache(params.atom_diag_cache).store(cache_key, h_diag);
+  }
 
   // FIXME save h_loc to be able to rebuild h_diag in an analysis program.
   //if (_comm.rank() ==0) h5_write(h5::file("h_loc.h5",'w'), "h_loc", _h_loc, fops);
@@ -194,92 +541,409 @@ void solver_core::solve(solve_parameters_t const & params) {
    return;
   }
 
-  // Initialise Monte Carlo quantities
-  qmc_data data(beta, params, h_diag, linindex, _Delta_tau, n_inner, histo_map);
-  auto qmc = mc_tools::mc_generic<mc_weight_t>(params.random_name, params.random_seed, 1.0, params.verbosity);
+  // Energy truncation of the atomic basis used in the trace
+  double energy_cutoff = params.energy_cutoff;
+  if (params.boltzmann_cutoff > 0) {
+   double e = -std::log(params.boltzmann_cutoff) / beta;
+   energy_cutoff = (energy_cutoff < 0 ? e : std::min(energy_cutoff, e));
+  }
+  atom_diag h_diag_truncated;
+  std::vector<int> block_map; // block_map[B] : block of h_diag_truncated for the block B of h_diag, -1 if removed
+  if (energy_cutoff >= 0) {
+   std::tie(h_diag_truncated, block_map) = h_diag.truncated(energy_cutoff);
+   if (h_diag_truncated.n_blocks() == 0) TRIQS_RUNTIME_ERROR << "The energy cutoff " << energy_cutoff << " removes all the atomic states";
+   double discarded_weight = 1 - partition_function(h_diag_truncated, beta) / partition_function(h_diag, beta);
+   if (params.verbosity >= 2)
+    std::cout << "Energy cutoff " << energy_cutoff << ": keeping " << h_diag_truncated.get_full_hilbert_space_dim() << " of "
+              << h_diag.get_full_hilbert_space_dim() << " atomic states in " << h_diag_truncated.n_blocks() << " subspaces."
+              << std::endl
+              << "Discarded atomic weight: " << discarded_weight << std::endl;
+  }
+  atom_diag const& h_diag_qmc = (energy_cutoff >= 0 ? h_diag_truncated : h_diag);
+
+  if (params.n_chains < 1) TRIQS_RUNTIME_ERROR << "n_chains must be at least 1, not " << params.n_chains;
+  if ((params.n_chains > 1) && ((params.target_error > 0) || params.auto_length_cycle || !params.checkpoint_file.empty()))
+   TRIQS_RUNTIME_ERROR << "target_error, auto_length_cycle and checkpoint_file cannot be used with n_chains > 1";
+
+  if (!params.checkpoint_file.empty() && (params.target_error > 0))
+   TRIQS_RUNTIME_ERROR << "checkpoint_file cannot be used with target_error (the batches of the error are not saved)";
+
+  // Restart: if every node has a checkpoint file for the same problem and measures (cf problem_key) whose accumulation
+  // was not completed, each one resumes its accumulation: the configuration, the partial sums of the measures, their
+  // normalizations and the number of cycles done are restored, and only the remaining cycles are run, without warmup.
+  // Otherwise, a warm start begins with the last configuration of the previous solve.
+  std::string checkpoint_name, checkpoint_key;
+  if (!params.checkpoint_file.empty()) {
+   checkpoint_name = node_file_name(params.checkpoint_file, _comm.rank());
+   std::ostringstream measures;
+   measures << params.measure_g_tau << params.measure_g_l << params.measure_g_iw << params.measure_f_tau
+            << params.measure_g2 << params.measure_pert_order << params.measure_density_matrix << " "
+            << _G_tau_accum[0].mesh().size() << " " << _G_l[0].mesh().size() << " " << _G_iw_measured[0].mesh().size()
+            << " " << params.g2_n_fermionic << " " << params.g2_n_bosonic << " " << params.use_norm_as_weight << " "
+            << params.partition_method << " " << params.energy_cutoff << " " << params.boltzmann_cutoff;
+   checkpoint_key = problem_key(beta, _h_loc, _Delta_tau, measures.str());
+  }
+  bool restart = false;
+  if (!checkpoint_name.empty()) {
+   int can_restart = (can_restart_from(checkpoint_name, checkpoint_key) ? 1 : 0);
+   restart = (mpi_all_reduce(can_restart, _comm) == _comm.size());
+  }
+  configuration_data_t initial_config;
+  if (params.warm_start) initial_config = _last_configuration;
+
+  // The run segment (0 for the first run, one more at each restart), and for a restart, the weight sums of the cycles
+  // done and the length of their cycle
+  int segment = 0, resumed_length_cycle = params.length_cycle;
+  weight_sums_t done;
+  if (restart) {
+   triqs::h5::file f(checkpoint_name.c_str(), H5F_ACC_RDONLY);
+   triqs::h5::group g(f);
+   h5_read(g, "configuration", initial_config);
+   h5_read(g, "segment", segment);
+   h5_read(g, "length_cycle", resumed_length_cycle);
+   done = markov_chain::read_weight_sums(g.open_group("sums"));
+   ++segment;
+   if (params.verbosity >= 2)
+    std::cout << "Restarting from " << checkpoint_name << " (" << initial_config.size() << " operators, " << done.num
+              << " cycles done)" << std::endl;
+  }
 
-  // Moves
-  using move_set_type = mc_tools::move_set<mc_weight_t>;
-  move_set_type inserts(qmc.get_rng());
-  move_set_type removes(qmc.get_rng());
-  move_set_type double_inserts(qmc.get_rng());
-  move_set_type double_removes(qmc.get_rng());
+  // Initialise Monte Carlo quantities. The determinants of the initial configuration are computed with the new Delta
+  // and its trace with the new h_loc: if its weight is now zero, start from the empty configuration.
+  // Delta(tau) is tabulated once for the determinants of all the chains.
+  auto deltas = qmc_data::make_delta_adaptors(_Delta_tau, params);
+  auto make_data = [&](configuration_data_t const& c, histo_map_t* h) {
+   return std::unique_ptr<qmc_data>{new qmc_data(beta, params, h_diag_qmc, linindex, deltas, n_inner, h, c)};
+  };
+  // The initial configuration may also have two operators at the same time after the rescaling to the new beta
+  std::unique_ptr<qmc_data> data_ptr;
+  auto start_from_empty = [&]() {
+   if (params.verbosity >= 2) std::cout << "Cannot start from the previous configuration, starting from the empty one" << std::endl;
+   data_ptr = make_data({}, histo_map);
+   restart = false;
+   segment = 0;
+   resumed_length_cycle = params.length_cycle;
+   done = {};
+  };
+  try {
+   data_ptr = make_data(initial_config, histo_map);
+  } catch (triqs::runtime_error const&) {
+   if (initial_config.size() == 0) throw;
+   start_from_empty();
+  } catch (rbt_insert_error const&) {
+   start_from_empty();
+  }
 
+  // The Markov chains of this node. They share h_diag_qmc and the tables of Delta(tau), and have their own qmc_data,
+  // random number generator and accumulators. Only the first one starts from initial_config, fills the performance
+  // histograms and prints. The seed of the chain c is random_seed + 1009 * c, different from the seeds of the chains of
+  // the other nodes with the default random_seed.
+  // The state of the random number generator cannot be saved (mc_tools::random_generator does not expose it): a
+  // restart continues with a new seed, + 7919 * segment, so that the segments are independent streams, not the same
+  // one again. The result is a valid Monte Carlo average, but not the one of the run without interruption.
+  std::vector<std::unique_ptr<markov_chain>> chains;
+  for (int c = 0; c < params.n_chains; ++c) {
+   auto d = (c == 0 ? std::move(data_ptr) : make_data({}, nullptr));
+   int seed = params.random_seed + 1009 * c + 7919 * segment;
+   chains.emplace_back(new markov_chain(std::move(d), params.random_name, seed, (c == 0 ? params.verbosity : 0)));
+  }
   auto& delta_names = _Delta_tau.domain().names();
   auto get_prob_prop = [&params](std::string const& block_name) {
    auto f = params.proposal_prob.find(block_name);
    return (f != params.proposal_prob.end() ? f->second : 1.0);
   };
-  for (size_t block = 0; block < _Delta_tau.domain().size(); ++block) {
-   int block_size = _Delta_tau[block].data().shape()[1];
-   auto const& block_name = delta_names[block];
-   double prop_prob = get_prob_prop(block_name);
-   inserts.add(move_insert_c_cdag(block, block_size, block_name,
-                                  data, qmc.get_rng(), histo_map), "Insert Delta_" + block_name, prop_prob);
-   removes.add(move_remove_c_cdag(block, block_size, block_name,
-                                  data, qmc.get_rng(), histo_map), "Remove Delta_" + block_name, prop_prob);
+
+  if (params.measure_density_matrix && !params.use_norm_as_weight)
+   TRIQS_RUNTIME_ERROR << "To measure the density_matrix of atomic states, you need to set "
+                          "use_norm_as_weight to True, i.e. to reweight the QMC";
+
+  for (auto& chain : chains) {
+   qmc_data& data = *chain->data;
+   auto& qmc = chain->qmc;
+   auto histo_map_chain = (chain == chains[0] ? histo_map : nullptr);
+
+   // Moves
+   using move_set_type = mc_tools::move_set<mc_weight_t>;
+   move_set_type inserts(qmc.get_rng());
+   move_set_type removes(qmc.get_rng());
+   move_set_type double_inserts(qmc.get_rng());
+   move_set_type double_removes(qmc.get_rng());
+
+   for (size_t block = 0; block < _Delta_tau.domain().size(); ++block) {
+    int block_size = _Delta_tau[block].data().shape()[1];
+    auto const& block_name = delta_names[block];
+    double prop_prob = get_prob_prop(block_name);
+    inserts.add(move_insert_c_cdag(block, block_size, block_name,
+                                   data, qmc.get_rng(), histo_map_chain), "Insert Delta_" + block_name, prop_prob);
+    removes.add(move_remove_c_cdag(block, block_size, block_name,
+                                   data, qmc.get_rng(), histo_map_chain), "Remove Delta_" + block_name, prop_prob);
+    if (params.move_double) {
+     for (size_t block2 = 0; block2 < _Delta_tau.domain().size(); ++block2) {
+      int block_size2 = _Delta_tau[block2].data().shape()[1];
+      auto const& block_name2 = delta_names[block2];
+      double prop_prob2 = get_prob_prop(block_name2);
+      double_inserts.add(move_insert_c_c_cdag_cdag(block, block2, block_size, block_size2, block_name, block_name2,
+                                                   data, qmc.get_rng(), histo_map_chain),
+                  "Insert Delta_" + block_name + "_" + block_name2, prop_prob*prop_prob2);
+      double_removes.add(move_remove_c_c_cdag_cdag(block, block2, block_size, block_size2, block_name, block_name2,
+                                                   data, qmc.get_rng(), histo_map_chain),
+                  "Remove Delta_" + block_name + "_" + block_name2, prop_prob*prop_prob2);
+     }
+    }
+   }
+
+   qmc.add_move(inserts, "Insert two operators", 1.0);
+   qmc.add_move(removes, "Remove two operators", 1.0);
    if (params.move_double) {
-    for (size_t block2 = 0; block2 < _Delta_tau.domain().size(); ++block2) {
-     int block_size2 = _Delta_tau[block2].data().shape()[1];
-     auto const& block_name2 = delta_names[block2];
-     double prop_prob2 = get_prob_prop(block_name2);
-     double_inserts.add(move_insert_c_c_cdag_cdag(block, block2, block_size, block_size2, block_name, block_name2,
-                                                  data, qmc.get_rng(), histo_map),
-                 "Insert Delta_" + block_name + "_" + block_name2, prop_prob*prop_prob2);
-     double_removes.add(move_remove_c_c_cdag_cdag(block, block2, block_size, block_size2, block_name, block_name2,
-                                                  data, qmc.get_rng(), histo_map),
-                 "Remove Delta_" + block_name + "_" + block_name2, prop_prob*prop_prob2);
+    qmc.add_move(double_inserts, "Insert four operators", 1.0);
+    qmc.add_move(double_removes, "Remove four operators", 1.0);
+   }
+   if (params.move_shift) qmc.add_move(move_shift_operator(data, qmc.get_rng(), histo_map_chain), "Shift one operator", 1.0);
+   // the window moves on average once every ~10 insertions/removals
+   if (params.n_move_windows > 1) qmc.add_move(move_slide_window(data), "Slide the time window", 0.2);
+
+   // Measurements, in the accumulators of the chain. On a restart, they resume with the normalizations of the cycles
+   // done (resumed), and the accumulators are read from the checkpoint below.
+   if (params.measure_g_tau) {
+    chain->G_tau_accum = _G_tau_accum;
+    auto& g_names = _G_tau.domain().names();
+    for (size_t block = 0; block < _G_tau.domain().size(); ++block) {
+     qmc.add_measure(resumed(measure_g(block, chain->G_tau_accum[block], data), done),
+                     "G measure (" + g_names[block] + ")");
     }
    }
+   if (params.measure_g_l) {
+    chain->G_l = _G_l;
+    auto& g_names = _G_l.domain().names();
+    for (size_t block = 0; block < _G_l.domain().size(); ++block) {
+     qmc.add_measure(resumed(measure_g_legendre(block, chain->G_l[block], data), done),
+                     "G_l measure (" + g_names[block] + ")");
+    }
+   }
+   if (params.measure_g_iw) {
+    chain->G_iw = _G_iw_measured;
+    chain->G_iw_grids.resize(_G_iw_measured.domain().size());
+    auto& g_names = _G_iw_measured.domain().names();
+    for (size_t block = 0; block < _G_iw_measured.domain().size(); ++block) {
+     qmc.add_measure(resumed(measure_g_iw(block, chain->G_iw[block], chain->G_iw_grids[block], data), done),
+                     "G_iw measure (" + g_names[block] + ")");
+    }
+   }
+   if (params.measure_f_tau) {
+    chain->F_tau_accum = _F_tau_accum;
+    qmc.add_measure(resumed(measure_f_tau(chain->F_tau_accum, data, params.h_int, h_diag, block_map), done),
+                    "F measure");
+   }
+   if (params.measure_g2)
+    qmc.add_measure(
+        resumed(measure_g2(chain->G2_iw, data, params.g2_n_fermionic, params.g2_n_bosonic, params.n_g2_threads), done),
+        "G2 measure");
+   if (params.measure_pert_order) {
+    auto& g_names = _G_tau.domain().names();
+    for (size_t block = 0; block < _G_tau.domain().size(); ++block) {
+     auto const& block_name = g_names[block];
+     qmc.add_measure(measure_perturbation_hist(block, data, chain->pert_order[block_name]),
+                     "Perturbation order (" + block_name + ")");
+    }
+    qmc.add_measure(measure_perturbation_hist_total(data, chain->pert_order_total), "Perturbation order");
+   }
+
+   if (params.measure_density_matrix)
+    qmc.add_measure(resumed(measure_density_matrix{data, chain->density_matrix}, done),
+                    "Density Matrix for local static observable");
+
+   qmc.add_measure(resumed(measure_average_sign{data, chain->average_sign}, done), "Average sign");
+
+   // The weights of the chains in the combination of their results, of the target error, and the number of cycles
+   // done for the checkpoints
+   if ((params.n_chains > 1) || (params.target_error > 0) || !checkpoint_name.empty())
+    qmc.add_measure(measure_weight_sums{data, chain->weight_sums}, "Weight sums");
+  }
+  if (restart) {
+   triqs::h5::file f(checkpoint_name.c_str(), H5F_ACC_RDONLY);
+   chains[0]->read_sums(triqs::h5::group(f).open_group("sums"), params);
+  }
+  qmc_data& data = *chains[0]->data;
+  auto& qmc = chains[0]->qmc;
+
+  auto stop_callback = triqs::utility::clock_callback(params.max_time);
+  std::function<bool()> accumulation_stop = stop_callback;
+
+  // Target error: every n_cycles / 100 cycles, the measurements since the previous check are added as a batch of the
+  // target observable. The accumulation stops when the error from the batches of all nodes is below target_error.
+  // All nodes take the decision together, so max_time is also checked only then.
+  if (params.target_error > 0) {
+   auto const& obs = params.target_observable;
+   if (obs != "average_sign" && obs != "G_tau" && obs != "G_l")
+    TRIQS_RUNTIME_ERROR << "target_observable must be \"average_sign\", \"G_tau\" or \"G_l\", not \"" << obs << "\"";
+   if ((obs == "G_tau" && !params.measure_g_tau) || (obs == "G_l" && !params.measure_g_l))
+    TRIQS_RUNTIME_ERROR << "The target observable " << obs << " is not measured";
+
+   // The cumulated sums of the components of the observable (normalized as in collect_results), and of the weight
+   auto target_sums = [this, &obs, &chain = *chains[0]]() {
+    auto const& weight_sums = chain.weight_sums;
+    std::vector<double> v;
+    auto push = [&v](auto x, double c) {
+     v.push_back(std::real(x) * c);
+     if (triqs::is_complex<decltype(x)>::value) v.push_back(std::imag(x) * c);
+    };
+    double z = std::real(weight_sums.signed_sum);
+    if (obs == "average_sign") {
+     push(weight_sums.signed_sum, 1);
+     z = weight_sums.abs_sum;
+    } else if (obs == "G_tau") {
+     for (size_t b = 0; b < chain.G_tau_accum.domain().size(); ++b) {
+      auto const& d = chain.G_tau_accum[b].data();
+      int n_tau = d.shape()[0];
+      double c = -1 / (beta * chain.G_tau_accum[b].mesh().delta());
+      for (int t = 0; t < n_tau; ++t)
+       for (int i = 0; i < d.shape()[1]; ++i)
+        for (int j = 0; j < d.shape()[2]; ++j) push(d(t, i, j), ((t == 0) || (t == n_tau - 1) ? 2 * c : c));
+     }
+    } else {
+     for (size_t b = 0; b < chain.G_l.domain().size(); ++b) {
+      auto const& d = chain.G_l[b].data();
+      for (int l = 0; l < d.shape()[0]; ++l)
+       for (int i = 0; i < d.shape()[1]; ++i)
+        for (int j = 0; j < d.shape()[2]; ++j) push(d(l, i, j), -std::sqrt(2.0 * l + 1.0) / beta);
+     }
+    }
+    arrays::vector<double> r(v.size());
+    for (size_t i = 0; i < v.size(); ++i) r(i) = v[i];
+    return std::make_pair(r, z);
+   };
+
+   auto target = std::make_shared<batch_error_estimator>(target_sums().first.size());
+   long check_period = std::max(1, params.n_cycles / 100), n_calls = 0;
+   accumulation_stop = [this, &params, &stop_callback, target_sums, target, check_period, n_calls]() mutable {
+    if (++n_calls % check_period != 0) return false;
+    auto s = target_sums();
+    target->add_batch(s.first, s.second);
+    double error = target->max_error(_comm);
+    int stop = ((error < params.target_error) || stop_callback() ? 1 : 0);
+    if (params.verbosity >= 3)
+     std::cout << "Error of " << params.target_observable << ": " << error << " (target " << params.target_error << ")" << std::endl;
+    return mpi_all_reduce(stop, _comm) > 0; // all the nodes stop together
+   };
   }
 
-  qmc.add_move(inserts, "Insert two operators", 1.0);
-  qmc.add_move(removes, "Remove two operators", 1.0);
-  if (params.move_double) {
-   qmc.add_move(double_inserts, "Insert four operators", 1.0);
-   qmc.add_move(double_removes, "Remove four operators", 1.0);
+  // Checkpoints: the configuration and the partial sums of the measures of this node are saved every
+  // checkpoint_interval seconds of the accumulation, after the measure of a cycle, and at the end
+  auto write_checkpoint = [this, &params, &chains, &checkpoint_name, &checkpoint_key, &segment](bool completed) {
+   write_checkpoint_file(checkpoint_name, *chains[0], params, checkpoint_key, segment, _length_cycle, completed);
+  };
+  if (!checkpoint_name.empty() && (params.checkpoint_interval > 0)) {
+   auto stop = accumulation_stop;
+   int interval = params.checkpoint_interval;
+   auto checkpoint_due = std::function<bool()>(triqs::utility::clock_callback(interval));
+   accumulation_stop = [stop, write_checkpoint, interval, checkpoint_due]() mutable {
+    if (checkpoint_due()) {
+     write_checkpoint(false);
+     checkpoint_due = triqs::utility::clock_callback(interval);
+    }
+    return stop();
+   };
   }
-  if (params.move_shift) qmc.add_move(move_shift_operator(data, qmc.get_rng(), histo_map), "Shift one operator", 1.0);
 
-  // Measurements
-  if (params.measure_g_tau) {
-   auto& g_names = _G_tau.domain().names();
-   for (size_t block = 0; block < _G_tau.domain().size(); ++block) {
-    qmc.add_measure(measure_g(block, _G_tau_accum[block], data), "G measure (" + g_names[block] + ")");
-   }
+  // Run! The sign of the starting configuration is data.initial_sign. A restart has no warmup, and keeps the length of
+  // the cycle of the checkpoint.
+  _length_cycle = (restart ? resumed_length_cycle : params.length_cycle);
+  if (params.n_chains > 1) {
+   // The chains run in parallel, each until n_cycles or max_time. The warmups of all the chains end before the
+   // accumulations start, cf chain_exit_order for the signal handler.
+   std::vector<int> status(params.n_chains, 0);
+   thread_pool chain_threads(params.n_chains);
+   auto run_chains = [&](long n_cycles, bool accumulate) {
+    if (n_cycles <= 0) return;
+    std::vector<bool> active(params.n_chains);
+    for (int c = 0; c < params.n_chains; ++c) active[c] = (status[c] == 0);
+    chain_exit_order exit_order(active);
+    triqs::signal_handler::start();
+    chain_threads.run(params.n_chains, [&](int c, int) {
+     if (!active[c]) return;
+     auto& chain_qmc = chains[c]->qmc;
+     auto stop = exit_order.stop_callback(c, n_cycles, stop_callback);
+     try {
+      status[c] = (accumulate ? chain_qmc.accumulate(n_cycles, params.length_cycle, stop)
+                              : chain_qmc.warmup(n_cycles, params.length_cycle, stop));
+     } catch (...) {
+      exit_order.leave(c);
+      throw;
+     }
+     exit_order.leave(c);
+    });
+   };
+   run_chains(params.n_warmup_cycles, false);
+   run_chains(params.n_cycles, true);
+   _solve_status = *std::max_element(status.begin(), status.end());
+  } else if (params.auto_length_cycle && !restart) {
+   // Calibration of length_cycle: the second half of the warmup is done one move at a time, measuring the
+   // autocorrelation times after each move
+   int n_thermalization = params.n_warmup_cycles / 2;
+   long n_calibration = long(params.n_warmup_cycles - n_thermalization) * params.length_cycle;
+   measure_autocorrelation autocorrelation{data};
+   _solve_status = qmc.warmup(n_thermalization, params.length_cycle, stop_callback);
+   qmc.set_after_cycle_duty([&autocorrelation]() { autocorrelation.accumulate(); });
+   if (_solve_status == 0) _solve_status = qmc.warmup(n_calibration, 1, stop_callback);
+   qmc.set_after_cycle_duty([]() {});
+   _length_cycle = autocorrelation.length_cycle(_comm);
+   if (params.verbosity >= 2) std::cout << "Length of the QMC cycle from the autocorrelation times: " << _length_cycle << std::endl;
+  } else if (!restart)
+   _solve_status = qmc.warmup(params.n_warmup_cycles, params.length_cycle, stop_callback);
+  // The accumulation runs the cycles not done yet: all of them, except on a restart
+  bool accumulating = (params.n_chains == 1) && (_solve_status == 0);
+  if (accumulating && (params.n_cycles > done.num))
+   _solve_status = qmc.accumulate(params.n_cycles - done.num, _length_cycle, accumulation_stop);
+  // A completed accumulation removes its checkpoint, so that the next solve with the same parameters does not restart
+  // from it (or marks it as completed if it cannot be removed). An interrupted one is saved, to be resumed. An
+  // interrupted warmup has nothing to resume: the next solve starts again.
+  if (!checkpoint_name.empty()) {
+   if (_solve_status != 0) {
+    if (accumulating) write_checkpoint(false);
+   } else if (std::ifstream(checkpoint_name).good() && (std::remove(checkpoint_name.c_str()) != 0))
+    write_checkpoint(true);
   }
-  if (params.measure_g_l) {
-   auto& g_names = _G_l.domain().names();
-   for (size_t block = 0; block < _G_l.domain().size(); ++block) {
-    qmc.add_measure(measure_g_legendre(block, _G_l[block], data), "G_l measure (" + g_names[block] + ")");
-   }
+  _last_configuration = data.config.get_data();
+
+  // Several chains: each collects its own results first, then they are combined with those of the other nodes
+  if (params.n_chains == 1)
+   qmc.collect_results(_comm);
+  else {
+   triqs::mpi::communicator self(MPI_COMM_SELF);
+   for (auto& chain : chains) chain->qmc.collect_results(self);
+   combine_chains(chains, params, _comm);
   }
+  auto const& results = *chains[0];
+  if (params.measure_g_tau) _G_tau_accum = results.G_tau_accum;
+  if (params.measure_g_l) _G_l = results.G_l;
+  if (params.measure_g_iw) _G_iw_measured = results.G_iw;
+  if (params.measure_f_tau) _F_tau_accum = results.F_tau_accum;
+  if (params.measure_g2) _G2_iw = results.G2_iw;
   if (params.measure_pert_order) {
-   auto& g_names = _G_tau.domain().names();
-   for (size_t block = 0; block < _G_tau.domain().size(); ++block) {
-    auto const& block_name = g_names[block];
-    qmc.add_measure(measure_perturbation_hist(block, data, _pert_order[block_name]), "Perturbation order (" + block_name + ")");
-   }
-   qmc.add_measure(measure_perturbation_hist_total(data, _pert_order_total), "Perturbation order");
+   _pert_order_total = results.pert_order_total;
+   _pert_order = results.pert_order;
   }
-
-  if (params.measure_density_matrix) {
-   if (!params.use_norm_as_weight)
-    TRIQS_RUNTIME_ERROR << "To measure the density_matrix of atomic states, you need to set "
-                           "use_norm_as_weight to True, i.e. to reweight the QMC";
-   qmc.add_measure(measure_density_matrix{data, _density_matrix}, "Density Matrix for local static observable");
+  if (params.measure_density_matrix) _density_matrix = results.density_matrix;
+  _average_sign = results.average_sign;
+
+  // Back to the blocks of the full atomic basis: the discarded states have a zero density matrix
+  if (params.measure_density_matrix && (energy_cutoff >= 0)) {
+   std::vector<matrix_t> dm(h_diag.n_blocks());
+   for (int bl = 0; bl < h_diag.n_blocks(); ++bl) {
+    dm[bl] = matrix_t(h_diag.get_block_dim(bl), h_diag.get_block_dim(bl));
+    dm[bl]() = 0;
+    if (block_map[bl] == -1) continue;
+    auto r = range(0, h_diag_truncated.get_block_dim(block_map[bl]));
+    dm[bl](r, r) = _density_matrix[block_map[bl]];
+   }
+   _density_matrix = std::move(dm);
   }
 
-  qmc.add_measure(measure_average_sign{data, _average_sign}, "Average sign");
-
-  // Run! The empty (starting) configuration has sign = 1
-  _solve_status = qmc.warmup_and_accumulate( params.n_warmup_cycles, params.n_cycles, params.length_cycle, triqs::utility::clock_callback(params.max_time));
-  qmc.collect_results(_comm);
-
   if (params.verbosity >= 2) std::cout << "Average sign: " << _average_sign << std::endl;
 
   // Copy local (real or complex) G_tau back to complex G_tau
   if (params.measure_g_tau) _G_tau = _G_tau_accum;
+  if (params.measure_f_tau) _F_tau = _F_tau_accum;
 
 }
 
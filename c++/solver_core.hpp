@@ -26,6 +26,7 @@
 #include "solve_parameters.hpp"
 #include "atom_diag.hpp"
 #include "atom_diag_functions.hpp"
+#include "configuration.hpp"
 
 namespace cthyb {
 
@@ -45,6 +46,10 @@ class solver_core {
  block_gf<imtime> _Delta_tau, _G_tau;           // Green's function containers: imaginary-time Green's functions
  block_gf<imtime, g_target_t> _G_tau_accum;     // Intermediate object to accumulate g(tau), either real or complex
  block_gf<legendre> _G_l;                       // Green's function containers: Legendre coefficients
+ block_gf<imfreq> _G_iw_measured;               // Green's function containers: measured Matsubara frequencies
+ block_gf<imtime> _F_tau;                       // Improved estimator F(tau) = Sigma G in imaginary time
+ block_gf<imtime, g_target_t> _F_tau_accum;     // Intermediate object to accumulate F(tau), either real or complex
+ std::vector<array<dcomplex, 7>> _G2_iw;        // Two-particle Green's function, for each pair of blocks
  histogram _pert_order_total;                   // Histogram of the total perturbation order
  histo_map_t _pert_order;                       // Histograms of the perturbation order for each block
  std::vector<matrix_t> _density_matrix;         // density matrix, when used in Norm mode
@@ -53,6 +58,8 @@ class solver_core {
  histo_map_t _performance_analysis;             // Histograms used for performance analysis
  mc_weight_t _average_sign;                     // average sign of the QMC
  int _solve_status;                             // Status of the solve upon exit: 0 for clean termination, > 0 otherwise.
+ int _length_cycle;                             // Length of the QMC cycle used in the last call to solve
+ configuration_data_t _last_configuration;      // Configuration of this node at the end of the last call to solve
 
  public:
  solver_core(double beta, std::map<std::string, indices_type> const & gf_struct, int n_iw=1025, int n_tau=10001, int n_l=50);
@@ -79,6 +86,15 @@ class solver_core {
  /// G_l in Legendre polynomials representation
  block_gf_view<legendre> G_l() { return _G_l; }
 
+ /// G(iw) measured in Matsubara frequencies
+ block_gf_view<imfreq> G_iw_measured() { return _G_iw_measured; }
+
+ /// F(tau) = -<T [c, h_int](tau) c^dagger(0)> in imaginary time, Sigma(iw) = F(iw) G(iw)^{-1}
+ block_gf_view<imtime> F_tau() { return _F_tau; }
+
+ /// G2(iW, iw, iw') for the pairs of blocks A, B at A * n_blocks + B, with indices (W, w, w', a, b, c, d)
+ std::vector<array<dcomplex, 7>> const& G2_iw() const { return _G2_iw; }
+
  /// Atomic G(tau) in imaginary time
  block_gf_view<imtime> atomic_gf() const { return ::cthyb::atomic_gf(h_diag, beta, gf_struct, _G_tau[0].mesh().size()); }
 
@@ -103,6 +119,18 @@ class solver_core {
  /// Status of the solve on exit
  int solve_status() const { return _solve_status; }
 
+ /// Length of the QMC cycle used in the last call to solve (computed if auto_length_cycle)
+ int length_cycle() const { return _length_cycle; }
+
+ /// Configuration of this node at the end of the last call to solve, the start of the next one if warm_start
+ TRIQS_CPP2PY_IGNORE configuration_data_t const& last_configuration() const { return _last_configuration; }
+
+ /// Save the last configuration of this node in <prefix>_<rank>.h5, as the checkpoint files
+ void save_last_configuration(std::string const& prefix) const;
+
+ /// Read the last configuration of this node from <prefix>_<rank>.h5, to warm start the next solve
+ void load_last_configuration(std::string const& prefix);
+
 };
 
 }
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./config.hpp"
+#include <cmath>
+#include <vector>
+
+namespace cthyb {
+
+/********************************************
+ A matrix in compressed sparse row (CSR) format.
+
+ Used for the matrices of the C, C^dagger operators, which are mostly
+ zero for large blocks of some Hamiltonians.
+ ********************************************/
+struct csr_matrix_t {
+ int n_rows = 0, n_cols = 0;
+ std::vector<int> row_start;      // the non-zero elements of row i are [row_start[i], row_start[i+1][
+ std::vector<int> cols;           // column of each non-zero element
+ std::vector<h_scalar_t> values;  // value of each non-zero element
+
+ long n_nonzeros() const { return values.size(); }
+};
+
+// Elements with a modulus below this are considered zero (round-off of the change of basis)
+constexpr double sparse_zero_threshold = 1.e-15;
+
+// Above this fraction of non-zero elements, the dense matrix is faster
+constexpr double max_sparse_fill_ratio = 0.25;
+
+// Fraction of non-zero elements of m
+inline double fill_ratio(matrix_t const& m) {
+ long n = 0, size = first_dim(m) * second_dim(m);
+ if (size == 0) return 1;
+ for (int i = 0; i < first_dim(m); ++i)
+  for (int j = 0; j < second_dim(m); ++j)
+   if (std::abs(m(i, j)) >= sparse_zero_threshold) ++n;
+ return double(n) / size;
+}
+
+// The CSR representation of m
+inline csr_matrix_t make_csr_matrix(matrix_t const& m) {
+ csr_matrix_t r;
+ r.n_rows = first_dim(m);
+ r.n_cols = second_dim(m);
+ r.row_start.reserve(r.n_rows + 1);
+ r.row_start.push_back(0);
+ for (int i = 0; i < r.n_rows; ++i) {
+  for (int j = 0; j < r.n_cols; ++j)
+   if (std::abs(m(i, j)) >= sparse_zero_threshold) {
+    r.cols.push_back(j);
+    r.values.push_back(m(i, j));
+   }
+  r.row_start.push_back(r.values.size());
+ }
+ return r;
+}
+}
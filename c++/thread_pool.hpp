@@ -0,0 +1,123 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cthyb {
+
+/********************************************
+ A small pool of persistent threads.
+
+ run(n_tasks, f) calls f(task, worker) for all task in [0, n_tasks[ and
+ returns when all tasks are done. The calling thread is worker 0, the
+ threads of the pool are workers 1 ... n_workers()-1.
+ An exception thrown by a task is rethrown by run.
+ ********************************************/
+class thread_pool {
+
+ public:
+ thread_pool(int n_workers) {
+  for (int w = 1; w < n_workers; ++w) threads.emplace_back([this, w]() { worker_loop(w); });
+ }
+
+ ~thread_pool() {
+  {
+   std::lock_guard<std::mutex> lock(mutex);
+   stopping = true;
+  }
+  wake_workers.notify_all();
+  for (auto& t : threads) t.join();
+ }
+
+ thread_pool(thread_pool const&) = delete;
+ thread_pool& operator=(thread_pool const&) = delete;
+
+ int n_workers() const { return threads.size() + 1; }
+
+ void run(int n_tasks, std::function<void(int, int)> const& f) {
+  if (threads.empty() || (n_tasks <= 1)) { // no need to wake anybody
+   for (int t = 0; t < n_tasks; ++t) f(t, 0);
+   return;
+  }
+  {
+   std::lock_guard<std::mutex> lock(mutex);
+   task = &f;
+   n_total = n_tasks;
+   n_started = 0;
+   n_done = 0;
+   error = nullptr;
+   ++generation;
+  }
+  wake_workers.notify_all();
+  work(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  all_done.wait(lock, [this]() { return n_done == n_total; });
+  task = nullptr;
+  if (error) std::rethrow_exception(error);
+ }
+
+ private:
+ std::vector<std::thread> threads;
+ std::mutex mutex;
+ std::condition_variable wake_workers, all_done;
+ std::function<void(int, int)> const* task = nullptr;
+ int n_total = 0, n_started = 0, n_done = 0;
+ long generation = 0; // incremented at each run, so that a worker does not take the same run twice
+ bool stopping = false;
+ std::exception_ptr error;
+
+ // take the next tasks of the current run until there is none left
+ void work(int w) {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (n_started < n_total) {
+   int t = n_started++;
+   auto f = task;
+   lock.unlock();
+   try {
+    (*f)(t, w);
+   } catch (...) {
+    std::lock_guard<std::mutex> l(mutex);
+    if (!error) error = std::current_exception();
+   }
+   lock.lock();
+   if (++n_done == n_total) all_done.notify_all();
+  }
+ }
+
+ void worker_loop(int w) {
+  long seen = 0;
+  while (true) {
+   {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake_workers.wait(lock, [&]() { return stopping || (generation != seen); });
+    if (stopping) return;
+    seen = generation;
+   }
+   work(w);
+  }
+ }
+};
+}
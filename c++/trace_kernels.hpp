@@ -0,0 +1,159 @@
+/*******************************************************************************
+ *
+ * TRIQS: a Toolbox for Research in Interacting Quantum Systems
+ *
+ * Copyright (C) 2014, P. Seth, I. Krivenko, M. Ferrero and O. Parcollet
+ *
+ * TRIQS is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * TRIQS is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * TRIQS. If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#pragma once
+#include "./config.hpp"
+#include "./sparse_matrix.hpp"
+#include <triqs/arrays/blas_lapack/gemm.hpp>
+#include <cmath>
+
+namespace cthyb {
+
+/********************************************
+ Products of block matrices for the trace.
+
+ All matrices are stored row-major in raw buffers (cache slabs of the
+ tree nodes, or scratch buffers), so that no temporary is allocated.
+ ********************************************/
+namespace kernels {
+
+ // Below this number of multiply-adds, the hand-written kernel is faster than a BLAS call
+ // (the overhead of the call dominates for the dimensions of most blocks, 2 to ~20)
+ constexpr long small_product_size = 32 * 32 * 32;
+
+ // C = A * B for small matrices. Four rows of C are computed together, so that each row of B is loaded once for
+ // four rows of A. The inner loop on j is contiguous and vectorized by the compiler.
+ inline void small_gemm(int n1, int n2, int k, h_scalar_t const* __restrict__ A, h_scalar_t const* __restrict__ B,
+                        h_scalar_t* __restrict__ C) {
+  int i = 0;
+  for (; i + 4 <= n1; i += 4) {
+   h_scalar_t* __restrict__ c0 = C + i * n2;
+   h_scalar_t* __restrict__ c1 = c0 + n2;
+   h_scalar_t* __restrict__ c2 = c1 + n2;
+   h_scalar_t* __restrict__ c3 = c2 + n2;
+   for (int j = 0; j < n2; ++j) c0[j] = c1[j] = c2[j] = c3[j] = 0;
+   for (int u = 0; u < k; ++u) {
+    h_scalar_t a0 = A[i * k + u], a1 = A[(i + 1) * k + u], a2 = A[(i + 2) * k + u], a3 = A[(i + 3) * k + u];
+    h_scalar_t const* __restrict__ b = B + u * n2;
+    for (int j = 0; j < n2; ++j) {
+     c0[j] += a0 * b[j];
+     c1[j] += a1 * b[j];
+     c2[j] += a2 * b[j];
+     c3[j] += a3 * b[j];
+    }
+   }
+  }
+  for (; i < n1; ++i) { // remaining rows
+   h_scalar_t* __restrict__ c = C + i * n2;
+   for (int j = 0; j < n2; ++j) c[j] = 0;
+   for (int u = 0; u < k; ++u) {
+    h_scalar_t a = A[i * k + u];
+    h_scalar_t const* __restrict__ b = B + u * n2;
+    for (int j = 0; j < n2; ++j) c[j] += a * b[j];
+   }
+  }
+ }
+
+ // C = A * B, with A : n1 x k, B : k x n2, C : n1 x n2. C must not alias A or B.
+ inline void gemm(int n1, int n2, int k, h_scalar_t const* A, h_scalar_t const* B, h_scalar_t* C) {
+  if (long(n1) * n2 * k <= small_product_size)
+   small_gemm(n1, n2, k, A, B, C);
+  else
+   // BLAS is column-major : compute C^T = B^T * A^T
+   triqs::arrays::blas::f77::gemm('N', 'N', n2, n1, k, h_scalar_t(1), B, n2, A, k, h_scalar_t(0), C, n2);
+ }
+
+ // ------- Products with a diagonal matrix in the middle : C = A * diag(d) * B -------
+ // A : n1 x k, d : k, B : k x n2, C : n1 x n2. This fuses the time evolution exp(-dtau*E) with the products.
+ // work has room for n1 * k elements and is used only by the generic version.
+ using scaled_gemm_t = void (*)(int n1, int n2, int k, h_scalar_t const* A, double const* d, h_scalar_t const* B,
+                                h_scalar_t* C, h_scalar_t* work);
+
+ inline void scaled_gemm_generic(int n1, int n2, int k, h_scalar_t const* A, double const* d, h_scalar_t const* B,
+                                 h_scalar_t* C, h_scalar_t* work) {
+  for (int i = 0; i < n1; ++i)
+   for (int u = 0; u < k; ++u) work[i * k + u] = A[i * k + u] * d[u];
+  gemm(n1, n2, k, work, B, C);
+ }
+
+ // Version with the inner dimension K known at compile time : the loops on K are unrolled and A * diag(d) is kept in
+ // registers, one row at a time.
+ template <int K>
+ void scaled_gemm_fixed(int n1, int n2, int, h_scalar_t const* A, double const* d, h_scalar_t const* B, h_scalar_t* C,
+                        h_scalar_t*) {
+  for (int i = 0; i < n1; ++i) {
+   h_scalar_t a[K];
+   for (int u = 0; u < K; ++u) a[u] = A[i * K + u] * d[u];
+   h_scalar_t* c = C + i * n2;
+   for (int j = 0; j < n2; ++j) {
+    h_scalar_t r = 0;
+    for (int u = 0; u < K; ++u) r += a[u] * B[u * n2 + j];
+    c[j] = r;
+   }
+  }
+ }
+
+ // Same with a sparse A (n1 x k) : C = A * diag(d) * B, B : k x n2, C : n1 x n2.
+ inline void sparse_scaled_gemm(csr_matrix_t const& A, int n2, double const* d, h_scalar_t const* __restrict__ B,
+                                h_scalar_t* __restrict__ C) {
+  for (int i = 0; i < A.n_rows; ++i) {
+   h_scalar_t* __restrict__ c = C + i * n2;
+   for (int j = 0; j < n2; ++j) c[j] = 0;
+   for (int p = A.row_start[i]; p < A.row_start[i + 1]; ++p) {
+    int u = A.cols[p];
+    h_scalar_t a = A.values[p] * d[u];
+    h_scalar_t const* __restrict__ b = B + u * n2;
+    for (int j = 0; j < n2; ++j) c[j] += a * b[j];
+   }
+  }
+ }
+
+ // The kernel for an inner dimension k : compile-time versions for k <= 8
+ inline scaled_gemm_t scaled_gemm_for_dim(int k) {
+  switch (k) {
+   case 1: return scaled_gemm_fixed<1>;
+   case 2: return scaled_gemm_fixed<2>;
+   case 3: return scaled_gemm_fixed<3>;
+   case 4: return scaled_gemm_fixed<4>;
+   case 5: return scaled_gemm_fixed<5>;
+   case 6: return scaled_gemm_fixed<6>;
+   case 7: return scaled_gemm_fixed<7>;
+   case 8: return scaled_gemm_fixed<8>;
+   default: return scaled_gemm_generic;
+  }
+ }
+
+ // out[i] = exp(-dtau * E[i]), i < n. Two plain loops on contiguous arrays, so that the compiler can use a vector exp.
+ inline void exp_evolution(int n, double dtau, double const* __restrict__ E, double* __restrict__ out) {
+  for (int i = 0; i < n; ++i) out[i] = -dtau * E[i];
+  for (int i = 0; i < n; ++i) out[i] = std::exp(out[i]);
+ }
+
+ // Frobenius norm of a matrix of size elements
+ inline double frobenius_norm(h_scalar_t const* A, long size) {
+  double r = 0;
+  for (long i = 0; i < size; ++i) {
+   auto ab = std::abs(A[i]);
+   r += ab * ab;
+  }
+  return std::sqrt(r);
+ }
+}
+}
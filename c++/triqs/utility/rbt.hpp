@@ -125,6 +125,20 @@ private : node root; // root of the BST
   return x->N;
  }
 
+ // recompute the subtree count of h from its children, and the subtree data of the Value if it has any:
+ // Value can summarize its subtree with a method void update_subtree(Value const* left, Value const* right),
+ // called with nullptr for an empty subtree.
+ void update_size(node h) {
+  h->N = size(h->left) + size(h->right) + 1;
+  update_subtree<Value>(h, h->left, h->right, 0);
+ }
+
+ template <typename V>
+ static auto update_subtree(V* h, V const* l, V const* r, int) -> decltype(h->update_subtree(l, r)) {
+  return h->update_subtree(l, r);
+ }
+ template <typename V> static void update_subtree(V*, V const*, V const*, long) {}
+
  void rec_free(node n) {
   if (n == nullptr) return;
   rec_free(n->left);
@@ -318,7 +332,11 @@ private : node root; // root of the BST
  private:
  // insert the key-value pair in the subtree rooted at h
  node insert(node h, Key const& key, Value const& val) {
-  if (h == nullptr) return new node_t(key, val, true, 1);
+  if (h == nullptr) {
+   node n = new node_t(key, val, true, 1);
+   update_size(n);
+   return n;
+  }
 
   if (compare(key,h->key))
    h->left = insert(h->left, key, val);
@@ -331,7 +349,7 @@ private : node root; // root of the BST
   if (is_red(h->right) && !is_red(h->left)) h = rotateLeft(h);
   if (is_red(h->left) && is_red(h->left->left)) h = rotateRight(h);
   if (is_red(h->left) && is_red(h->right)) flipColors(h);
-  h->N = size(h->left) + size(h->right) + 1;
+  update_size(h);
 
   h->modified = true;
   return h;
@@ -438,8 +456,8 @@ private : node root; // root of the BST
   x->right = h;
   x->color = x->right->color;
   x->right->color = RED;
-  x->N = h->N;
-  h->N = size(h->left) + size(h->right) + 1;
+  update_size(h);
+  update_size(x);
   h->modified = true;
   x->modified = true;
   return x;
@@ -453,8 +471,8 @@ private : node root; // root of the BST
   x->left = h;
   x->color = x->left->color;
   x->left->color = RED;
-  x->N = h->N;
-  h->N = size(h->left) + size(h->right) + 1;
+  update_size(h);
+  update_size(x);
   h->modified = true;
   x->modified = true;
   return x;
@@ -504,7 +522,7 @@ private : node root; // root of the BST
   if (is_red(h->left) && is_red(h->left->left)) h = rotateRight(h);
   if (is_red(h->left) && is_red(h->right)) flipColors(h);
 
-  h->N = size(h->left) + size(h->right) + 1;
+  update_size(h);
   h->modified = true;
   return h;
  }
@@ -614,6 +632,12 @@ private : node root; // root of the BST
   return x->key;
  }
 
+ /// The node of rank k
+ node select_node(int k) const {
+  if (k < 0 || k >= size()) TRIQS_RUNTIME_ERROR << " unknow key";
+  return select(root, k);
+ }
+
  private:
  // the key of rank k in the subtree rooted at x
  node select(node x, int k) const {
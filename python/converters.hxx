@@ -13,24 +13,45 @@ template <> struct py_converter<solve_parameters_t> {
   PyDict_SetItemString( d, "h_int"                 , convert_to_python(x.h_int));
   PyDict_SetItemString( d, "n_cycles"              , convert_to_python(x.n_cycles));
   PyDict_SetItemString( d, "partition_method"      , convert_to_python(x.partition_method));
+  PyDict_SetItemString( d, "energy_cutoff"         , convert_to_python(x.energy_cutoff));
+  PyDict_SetItemString( d, "boltzmann_cutoff"      , convert_to_python(x.boltzmann_cutoff));
   PyDict_SetItemString( d, "quantum_numbers"       , convert_to_python(x.quantum_numbers));
+  PyDict_SetItemString( d, "atom_diag_cache"       , convert_to_python(x.atom_diag_cache));
   PyDict_SetItemString( d, "length_cycle"          , convert_to_python(x.length_cycle));
+  PyDict_SetItemString( d, "auto_length_cycle"     , convert_to_python(x.auto_length_cycle));
   PyDict_SetItemString( d, "n_warmup_cycles"       , convert_to_python(x.n_warmup_cycles));
+  PyDict_SetItemString( d, "warm_start"            , convert_to_python(x.warm_start));
   PyDict_SetItemString( d, "random_seed"           , convert_to_python(x.random_seed));
   PyDict_SetItemString( d, "random_name"           , convert_to_python(x.random_name));
   PyDict_SetItemString( d, "max_time"              , convert_to_python(x.max_time));
+  PyDict_SetItemString( d, "target_error"          , convert_to_python(x.target_error));
+  PyDict_SetItemString( d, "target_observable"     , convert_to_python(x.target_observable));
+  PyDict_SetItemString( d, "checkpoint_file"       , convert_to_python(x.checkpoint_file));
+  PyDict_SetItemString( d, "checkpoint_interval"   , convert_to_python(x.checkpoint_interval));
   PyDict_SetItemString( d, "verbosity"             , convert_to_python(x.verbosity));
   PyDict_SetItemString( d, "move_shift"            , convert_to_python(x.move_shift));
   PyDict_SetItemString( d, "move_double"           , convert_to_python(x.move_double));
+  PyDict_SetItemString( d, "n_move_windows"        , convert_to_python(x.n_move_windows));
+  PyDict_SetItemString( d, "trace_method"          , convert_to_python(x.trace_method));
   PyDict_SetItemString( d, "use_trace_estimator"   , convert_to_python(x.use_trace_estimator));
   PyDict_SetItemString( d, "measure_g_tau"         , convert_to_python(x.measure_g_tau));
   PyDict_SetItemString( d, "measure_g_l"           , convert_to_python(x.measure_g_l));
+  PyDict_SetItemString( d, "measure_g_iw"          , convert_to_python(x.measure_g_iw));
+  PyDict_SetItemString( d, "measure_f_tau"         , convert_to_python(x.measure_f_tau));
+  PyDict_SetItemString( d, "measure_g2"            , convert_to_python(x.measure_g2));
+  PyDict_SetItemString( d, "g2_n_fermionic"        , convert_to_python(x.g2_n_fermionic));
+  PyDict_SetItemString( d, "g2_n_bosonic"          , convert_to_python(x.g2_n_bosonic));
+  PyDict_SetItemString( d, "n_g2_threads"          , convert_to_python(x.n_g2_threads));
   PyDict_SetItemString( d, "measure_pert_order"    , convert_to_python(x.measure_pert_order));
   PyDict_SetItemString( d, "measure_density_matrix", convert_to_python(x.measure_density_matrix));
   PyDict_SetItemString( d, "use_norm_as_weight"    , convert_to_python(x.use_norm_as_weight));
   PyDict_SetItemString( d, "performance_analysis"  , convert_to_python(x.performance_analysis));
+  PyDict_SetItemString( d, "n_trace_threads"       , convert_to_python(x.n_trace_threads));
+  PyDict_SetItemString( d, "n_diag_threads"        , convert_to_python(x.n_diag_threads));
+  PyDict_SetItemString( d, "n_chains"              , convert_to_python(x.n_chains));
   PyDict_SetItemString( d, "proposal_prob"         , convert_to_python(x.proposal_prob));
   PyDict_SetItemString( d, "imag_threshold"        , convert_to_python(x.imag_threshold));
+  PyDict_SetItemString( d, "delta_interpolation"   , convert_to_python(x.delta_interpolation));
   return d;
  }
 
@@ -53,24 +74,45 @@ template <> struct py_converter<solve_parameters_t> {
   res.h_int = convert_from_python<many_body_op_t>(PyDict_GetItemString(dic, "h_int"));
   res.n_cycles = convert_from_python<int>(PyDict_GetItemString(dic, "n_cycles"));
   _get_optional(dic, "partition_method"      , res.partition_method         ,"autopartition");
+  _get_optional(dic, "energy_cutoff"         , res.energy_cutoff            ,-1);
+  _get_optional(dic, "boltzmann_cutoff"      , res.boltzmann_cutoff         ,0);
   _get_optional(dic, "quantum_numbers"       , res.quantum_numbers          ,std::vector<many_body_op_t>{});
+  _get_optional(dic, "atom_diag_cache"       , res.atom_diag_cache          ,"");
   _get_optional(dic, "length_cycle"          , res.length_cycle             ,50);
+  _get_optional(dic, "auto_length_cycle"     , res.auto_length_cycle        ,false);
   _get_optional(dic, "n_warmup_cycles"       , res.n_warmup_cycles          ,5000);
+  _get_optional(dic, "warm_start"            , res.warm_start               ,false);
   _get_optional(dic, "random_seed"           , res.random_seed              ,34788+928374*triqs::mpi::communicator().rank());
   _get_optional(dic, "random_name"           , res.random_name              ,"");
   _get_optional(dic, "max_time"              , res.max_time                 ,-1);
+  _get_optional(dic, "target_error"          , res.target_error             ,-1);
+  _get_optional(dic, "target_observable"     , res.target_observable        ,"average_sign");
+  _get_optional(dic, "checkpoint_file"       , res.checkpoint_file          ,"");
+  _get_optional(dic, "checkpoint_interval"   , res.checkpoint_interval      ,600);
   _get_optional(dic, "verbosity"             , res.verbosity                ,((triqs::mpi::communicator().rank()==0)?3:0));
   _get_optional(dic, "move_shift"            , res.move_shift               ,true);
   _get_optional(dic, "move_double"           , res.move_double              ,false);
+  _get_optional(dic, "n_move_windows"        , res.n_move_windows           ,1);
+  _get_optional(dic, "trace_method"          , res.trace_method             ,"rb_tree");
   _get_optional(dic, "use_trace_estimator"   , res.use_trace_estimator      ,false);
   _get_optional(dic, "measure_g_tau"         , res.measure_g_tau            ,true);
   _get_optional(dic, "measure_g_l"           , res.measure_g_l              ,false);
+  _get_optional(dic, "measure_g_iw"          , res.measure_g_iw             ,false);
+  _get_optional(dic, "measure_f_tau"         , res.measure_f_tau            ,false);
+  _get_optional(dic, "measure_g2"            , res.measure_g2               ,false);
+  _get_optional(dic, "g2_n_fermionic"        , res.g2_n_fermionic           ,10);
+  _get_optional(dic, "g2_n_bosonic"          , res.g2_n_bosonic             ,1);
+  _get_optional(dic, "n_g2_threads"          , res.n_g2_threads             ,1);
   _get_optional(dic, "measure_pert_order"    , res.measure_pert_order       ,false);
   _get_optional(dic, "measure_density_matrix", res.measure_density_matrix   ,false);
   _get_optional(dic, "use_norm_as_weight"    , res.use_norm_as_weight       ,false);
   _get_optional(dic, "performance_analysis"  , res.performance_analysis     ,false);
+  _get_optional(dic, "n_trace_threads"       , res.n_trace_threads          ,1);
+  _get_optional(dic, "n_diag_threads"        , res.n_diag_threads           ,1);
+  _get_optional(dic, "n_chains"              , res.n_chains                 ,1);
   _get_optional(dic, "proposal_prob"         , res.proposal_prob            ,(std::map<std::string,double>{}));
   _get_optional(dic, "imag_threshold"        , res.imag_threshold           ,1.e-15);
+  _get_optional(dic, "delta_interpolation"   , res.delta_interpolation      ,"nearest");
   return res;
  }
 
@@ -101,7 +143,7 @@ template <> struct py_converter<solve_parameters_t> {
   std::stringstream fs, fs2; int err=0;
 
 #ifndef TRIQS_ALLOW_UNUSED_PARAMETERS
-  std::vector<std::string> ks, all_keys = {"h_int","n_cycles","partition_method","quantum_numbers","length_cycle","n_warmup_cycles","random_seed","random_name","max_time","verbosity","move_shift","move_double","use_trace_estimator","measure_g_tau","measure_g_l","measure_pert_order","measure_density_matrix","use_norm_as_weight","performance_analysis","proposal_prob","imag_threshold"};
+  std::vector<std::string> ks, all_keys = {"h_int","n_cycles","partition_method","energy_cutoff","boltzmann_cutoff","quantum_numbers","atom_diag_cache","length_cycle","auto_length_cycle","n_warmup_cycles","warm_start","random_seed","random_name","max_time","target_error","target_observable","checkpoint_file","checkpoint_interval","verbosity","move_shift","move_double","n_move_windows","trace_method","use_trace_estimator","measure_g_tau","measure_g_l","measure_g_iw","measure_f_tau","measure_g2","g2_n_fermionic","g2_n_bosonic","n_g2_threads","measure_pert_order","measure_density_matrix","use_norm_as_weight","performance_analysis","n_trace_threads","n_diag_threads","n_chains","proposal_prob","imag_threshold","delta_interpolation"};
   pyref keys = PyDict_Keys(dic);
   if (!convertible_from_python<std::vector<std::string>>(keys, true)) {
    fs << "\nThe dict keys are not strings";
@@ -116,24 +158,45 @@ template <> struct py_converter<solve_parameters_t> {
   _check_mandatory<many_body_op_t               >(dic, fs, err, "h_int"                 , "many_body_op_t");
   _check_mandatory<int                          >(dic, fs, err, "n_cycles"              , "int");
   _check_optional <std::string                  >(dic, fs, err, "partition_method"      , "std::string");
+  _check_optional <double                       >(dic, fs, err, "energy_cutoff"         , "double");
+  _check_optional <double                       >(dic, fs, err, "boltzmann_cutoff"      , "double");
   _check_optional <std::vector<many_body_op_t>  >(dic, fs, err, "quantum_numbers"       , "std::vector<many_body_op_t>");
+  _check_optional <std::string                  >(dic, fs, err, "atom_diag_cache"       , "std::string");
   _check_optional <int                          >(dic, fs, err, "length_cycle"          , "int");
+  _check_optional <bool                         >(dic, fs, err, "auto_length_cycle"     , "bool");
   _check_optional <int                          >(dic, fs, err, "n_warmup_cycles"       , "int");
+  _check_optional <bool                         >(dic, fs, err, "warm_start"            , "bool");
   _check_optional <int                          >(dic, fs, err, "random_seed"           , "int");
   _check_optional <std::string                  >(dic, fs, err, "random_name"           , "std::string");
   _check_optional <int                          >(dic, fs, err, "max_time"              , "int");
+  _check_optional <double                       >(dic, fs, err, "target_error"          , "double");
+  _check_optional <std::string                  >(dic, fs, err, "target_observable"     , "std::string");
+  _check_optional <std::string                  >(dic, fs, err, "checkpoint_file"       , "std::string");
+  _check_optional <int                          >(dic, fs, err, "checkpoint_interval"   , "int");
   _check_optional <int                          >(dic, fs, err, "verbosity"             , "int");
   _check_optional <bool                         >(dic, fs, err, "move_shift"            , "bool");
   _check_optional <bool                         >(dic, fs, err, "move_double"           , "bool");
+  _check_optional <int                          >(dic, fs, err, "n_move_windows"        , "int");
+  _check_optional <std::string                  >(dic, fs, err, "trace_method"          , "std::string");
   _check_optional <bool                         >(dic, fs, err, "use_trace_estimator"   , "bool");
   _check_optional <bool                         >(dic, fs, err, "measure_g_tau"         , "bool");
   _check_optional <bool                         >(dic, fs, err, "measure_g_l"           , "bool");
+  _check_optional <bool                         >(dic, fs, err, "measure_g_iw"          , "bool");
+  _check_optional <bool                         >(dic, fs, err, "measure_f_tau"         , "bool");
+  _check_optional <bool                         >(dic, fs, err, "measure_g2"            , "bool");
+  _check_optional <int                          >(dic, fs, err, "g2_n_fermionic"        , "int");
+  _check_optional <int                          >(dic, fs, err, "g2_n_bosonic"          , "int");
+  _check_optional <int                          >(dic, fs, err, "n_g2_threads"          , "int");
   _check_optional <bool                         >(dic, fs, err, "measure_pert_order"    , "bool");
   _check_optional <bool                         >(dic, fs, err, "measure_density_matrix", "bool");
   _check_optional <bool                         >(dic, fs, err, "use_norm_as_weight"    , "bool");
   _check_optional <bool                         >(dic, fs, err, "performance_analysis"  , "bool");
+  _check_optional <int                          >(dic, fs, err, "n_trace_threads"       , "int");
+  _check_optional <int                          >(dic, fs, err, "n_diag_threads"        , "int");
+  _check_optional <int                          >(dic, fs, err, "n_chains"              , "int");
   _check_optional <std::map<std::string, double>>(dic, fs, err, "proposal_prob"         , "std::map<std::string, double>");
   _check_optional <double                       >(dic, fs, err, "imag_threshold"        , "double");
+  _check_optional <std::string                  >(dic, fs, err, "delta_interpolation"   , "std::string");
   if (err) goto _error;
   return true;
 
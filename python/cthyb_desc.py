@@ -49,30 +49,64 @@ c.add_method("""void solve (**cthyb::solve_parameters_t)""",
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | partition_method       | str             | "autopartition"               | Partition method                                                               |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| energy_cutoff          | double          | -1 = keep all                 | Drop atomic eigenstates with an energy above the ground state larger than this |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| boltzmann_cutoff       | double          | 0 = keep all                  | Drop atomic eigenstates with a Boltzmann weight exp(-beta*E) below this        |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | quantum_numbers        | list(Operator)  | []                            | Quantum numbers                                                                |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| atom_diag_cache        | str             | ""                            | Directory of the cache of the diagonalizations of h_loc (empty: no cache)      |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | length_cycle           | int             | 50                            | Length of a single QMC cycle                                                   |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| auto_length_cycle      | bool            | false                         | Set length_cycle from the autocorrelation times measured during warmup?        |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | n_warmup_cycles        | int             | 5000                          | Number of cycles for thermalization                                            |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| warm_start             | bool            | false                         | Start from the last configuration of the previous solve (shorter warmup)?      |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | random_seed            | int             | 34788 + 928374 * MPI.rank     | Seed for random number generator                                               |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | random_name            | str             | ""                            | Name of random number generator                                                |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | max_time               | int             | -1 = infinite                 | Maximum runtime in seconds, use -1 to set infinite                             |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| target_error           | double          | -1 = off                      | Stop when the error of target_observable is below this (n_cycles: maximum)     |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| target_observable      | str             | "average_sign"                | Observable for target_error: "average_sign", "G_tau" or "G_l" (largest error)  |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| checkpoint_file        | str             | ""                            | Checkpoints <checkpoint_file>_<rank>.h5, to resume an interrupted accumulation |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| checkpoint_interval    | int             | 600                           | Seconds between two checkpoints during the accumulation                        |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | verbosity              | int             | 3 on MPI rank 0, 0 otherwise. | Verbosity level                                                                |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | move_shift             | bool            | true                          | Add shifting a move as a move?                                                 |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | move_double            | bool            | false                         | Add double insertions as a move?                                               |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| n_move_windows         | int             | 1                             | Insert/remove only in a sliding window of width beta/n_move_windows            |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| trace_method           | str             | "rb_tree"                     | Trace evaluation: "rb_tree", or "window" (products outside the window cached)  |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | use_trace_estimator    | bool            | false                         | Calculate the full trace or use an estimate?                                   |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | measure_g_tau          | bool            | true                          | Measure G(tau)?                                                                |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | measure_g_l            | bool            | false                         | Measure G_l (Legendre)?                                                        |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| measure_g_iw           | bool            | false                         | Measure G(iw) directly in Matsubara frequencies?                               |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| measure_f_tau          | bool            | false                         | Measure F(tau) = -<[c, h_int](tau) c^dagger> (improved estimator of Sigma)?    |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| measure_g2             | bool            | false                         | Measure the two-particle Green's function G2(iW, iw, iw')?                     |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| g2_n_fermionic         | int             | 10                            | Number of fermionic frequencies of G2 on each side of 0                        |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| g2_n_bosonic           | int             | 1                             | Number of bosonic frequencies of G2, from 0                                    |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| n_g2_threads           | int             | 1                             | Number of threads assembling G2 in each measure                                |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | measure_pert_order     | bool            | false                         | Measure perturbation order?                                                    |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | measure_density_matrix | bool            | false                         | Measure the contribution of each atomic state to the trace?                    |
@@ -81,9 +115,17 @@ c.add_method("""void solve (**cthyb::solve_parameters_t)""",
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | performance_analysis   | bool            | false                         | Analyse performance of trace computation with histograms (developers only)?    |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| n_trace_threads        | int             | 1                             | Number of threads computing the blocks of the trace in parallel                |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| n_diag_threads         | int             | 1                             | Number of threads diagonalizing the blocks of the local Hamiltonian            |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| n_chains               | int             | 1                             | Number of independent Markov chains run in parallel threads on each node       |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | proposal_prob          | dict(str:float) | {}                            | Operator insertion/removal probabilities for different blocks                  |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
 | imag_threshold         | double          | 1.e-15                        | Threshold below which imaginary components of Delta and h_loc are set to zero  |
++------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+
+| delta_interpolation    | str             | "nearest"                     | Interpolation of Delta(tau) between the mesh points: "nearest" or "linear"     |
 +------------------------+-----------------+-------------------------------+--------------------------------------------------------------------------------+ """)
 
 c.add_property(name = "h_loc",
@@ -110,6 +152,18 @@ c.add_property(name = "G_l",
                getter = cfunction("block_gf_view<legendre> G_l ()"),
                doc = """G_l in Legendre polynomials representation """)
 
+c.add_property(name = "G_iw_measured",
+               getter = cfunction("block_gf_view<imfreq> G_iw_measured ()"),
+               doc = """G(iw) measured in Matsubara frequencies """)
+
+c.add_property(name = "F_tau",
+               getter = cfunction("block_gf_view<imtime> F_tau ()"),
+               doc = """F(tau) = -<T [c, h_int](tau) c^dagger(0)> in imaginary time, Sigma(iw) = F(iw) G(iw)^{-1} """)
+
+c.add_property(name = "G2_iw",
+               getter = cfunction("std::vector<array<dcomplex,7>> G2_iw ()"),
+               doc = """G2(iW, iw, iw') for the pairs of blocks A, B at A * n_blocks + B, with indices (W, w, w', a, b, c, d) """)
+
 c.add_property(name = "atomic_gf",
                getter = cfunction("block_gf_view<imtime> atomic_gf ()"),
                doc = """Atomic G(tau) in imaginary time """)
@@ -142,6 +196,16 @@ c.add_property(name = "solve_status",
                getter = cfunction("int solve_status ()"),
                doc = """Status of the solve on exit """)
 
+c.add_method("""void save_last_configuration (std::string prefix)""",
+             doc = """Save the last configuration of this node in <prefix>_<rank>.h5, as the checkpoint files """)
+
+c.add_method("""void load_last_configuration (std::string prefix)""",
+             doc = """Read the last configuration of this node from <prefix>_<rank>.h5, to warm start the next solve """)
+
+c.add_property(name = "length_cycle",
+               getter = cfunction("int length_cycle ()"),
+               doc = """Length of the QMC cycle used in the last call to solve (computed if auto_length_cycle) """)
+
 module.add_class(c)
 
 
@@ -100,7 +100,14 @@ class Solver(SolverCore):
             # Fourier transform G_tau to obtain G_iw
             for name, g in self.G_tau: self.G_iw[name] << Fourier(g)
             # Solve Dyson's eq to obtain Sigma_iw and G_iw and fit the tail
-            self.Sigma_iw = dyson(G0_iw=self.G0_iw,G_iw=self.G_iw)
+            # (with the improved estimator Sigma_iw = F_iw G_iw^{-1} if F_tau was measured)
+            if self.last_solve_parameters["measure_f_tau"] == True:
+                for name, f in self.F_tau:
+                    F_iw = self.G_iw[name].copy()
+                    F_iw << Fourier(f)
+                    self.Sigma_iw[name] << F_iw * inverse(self.G_iw[name])
+            else:
+                self.Sigma_iw = dyson(G0_iw=self.G0_iw,G_iw=self.G_iw)
             if perform_tail_fit: tail_fit(Sigma_iw=self.Sigma_iw,G0_iw=self.G0_iw,G_iw=self.G_iw,\
                                           fit_min_n=fit_min_n,fit_max_n=fit_max_n,fit_min_w=fit_min_w,fit_max_w=fit_max_w,\
                                           fit_max_moment=fit_max_moment,fit_known_moments=fit_known_moments)
@@ -0,0 +1,79 @@
+#include "atom_diag_cache.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/test_tools/arrays.hpp>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+
+// Everything the solver uses from an atom_diag
+void check_same(atom_diag const& a, atom_diag const& b) {
+  ASSERT_EQ(a.n_blocks(), b.n_blocks());
+  EXPECT_EQ(a.get_full_hilbert_space_dim(), b.get_full_hilbert_space_dim());
+  EXPECT_EQ(a.get_fops().size(), b.get_fops().size());
+  EXPECT_EQ(a.get_gs_energy(), b.get_gs_energy());
+  EXPECT_EQ(a.get_vacuum_block_index(), b.get_vacuum_block_index());
+  EXPECT_EQ(a.get_vacuum_inner_index(), b.get_vacuum_inner_index());
+  EXPECT_TRUE(a.get_quantum_numbers() == b.get_quantum_numbers());
+  EXPECT_TRUE(a.get_fock_states() == b.get_fock_states());
+  for (int B = 0; B < a.n_blocks(); ++B) {
+    ASSERT_EQ(a.get_block_dim(B), b.get_block_dim(B));
+    EXPECT_ARRAY_NEAR(a.get_eigensystem()[B].eigenvalues, b.get_eigensystem()[B].eigenvalues);
+    EXPECT_ARRAY_NEAR(a.get_eigensystem()[B].unitary_matrix, b.get_eigensystem()[B].unitary_matrix);
+    for (int op = 0; op < a.get_fops().size(); ++op) {
+      EXPECT_EQ(a.c_connection(op, B), b.c_connection(op, B));
+      EXPECT_EQ(a.cdag_connection(op, B), b.cdag_connection(op, B));
+      if (a.c_connection(op, B) != -1) EXPECT_ARRAY_NEAR(a.c_matrix(op, B), b.c_matrix(op, B));
+      if (a.cdag_connection(op, B) != -1) EXPECT_ARRAY_NEAR(a.cdag_matrix(op, B), b.cdag_matrix(op, B));
+      EXPECT_EQ(a.c_sparse_matrix(op, B) == nullptr, b.c_sparse_matrix(op, B) == nullptr);
+      EXPECT_EQ(a.cdag_sparse_matrix(op, B) == nullptr, b.cdag_sparse_matrix(op, B) == nullptr);
+    }
+  }
+}
+
+TEST(AtomDiagCache, RoundTrip) {
+
+  fundamental_operator_set fops;
+  for (int o : {0, 1}) {
+    fops.insert("up", o);
+    fops.insert("dn", o);
+  }
+  double U = 2.0, ed0 = -1.1, ed1 = -0.9, V = 0.7;
+  auto H = U * n("up", 0) * n("dn", 0) + U * n("up", 1) * n("dn", 1);
+  H += ed0 * (n("up", 0) + n("dn", 0)) + ed1 * (n("up", 1) + n("dn", 1));
+  H += V * (c_dag("up", 0) * c("up", 1) + c_dag("up", 1) * c("up", 0) + c_dag("dn", 0) * c("dn", 1) +
+            c_dag("dn", 1) * c("dn", 0));
+  std::vector<many_body_op_t> qn{n("up", 0) + n("up", 1), n("dn", 0) + n("dn", 1)};
+
+  // The key depends on all the coefficients of h, on the partition method, and on the quantum numbers if they are used
+  auto key_qn = atom_diag_cache::make_key(H, fops, "quantum_numbers", qn);
+  auto key_auto = atom_diag_cache::make_key(H, fops, "autopartition", qn);
+  EXPECT_TRUE(key_qn != key_auto);
+  EXPECT_TRUE(key_qn != atom_diag_cache::make_key(H + 1.e-13 * n("up", 0), fops, "quantum_numbers", qn));
+  EXPECT_TRUE(key_qn != atom_diag_cache::make_key(H, fops, "quantum_numbers", {qn[0]}));
+  EXPECT_EQ(key_auto, atom_diag_cache::make_key(H, fops, "autopartition", {}));
+
+  atom_diag_cache cache(".");
+  atom_diag loaded;
+
+  // A key which is never stored
+  EXPECT_FALSE(cache.load(atom_diag_cache::make_key(H, fops, "none", {}), H, loaded));
+
+  // Store and load back, with each partition method
+  atom_diag h_qn(H, fops, qn), h_auto(H, fops);
+  cache.store(key_qn, h_qn);
+  cache.store(key_auto, h_auto);
+  ASSERT_TRUE(cache.load(key_qn, H, loaded));
+  check_same(h_qn, loaded);
+  ASSERT_TRUE(cache.load(key_auto, H, loaded));
+  check_same(h_auto, loaded);
+
+  // Storing again the same key replaces the entry
+  cache.store(key_qn, h_qn);
+  ASSERT_TRUE(cache.load(key_qn, H, loaded));
+  check_same(h_qn, loaded);
+}
+
+MAKE_MAIN;
@@ -0,0 +1,116 @@
+#include "atom_diag.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/test_tools/arrays.hpp>
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+
+fundamental_operator_set make_fops() {
+  fundamental_operator_set fops;
+  for (int o : {0, 1}) {
+    fops.insert("up", o);
+    fops.insert("dn", o);
+  }
+  return fops;
+}
+
+// All the eigenvalues, sorted
+std::vector<double> spectrum(atom_diag const& h_diag) {
+  std::vector<double> r;
+  for (int b = 0; b < h_diag.n_blocks(); ++b)
+    for (int i = 0; i < h_diag.get_block_dim(b); ++i) r.push_back(h_diag.get_eigenvalue(b, i));
+  std::sort(r.begin(), r.end());
+  return r;
+}
+
+// The block of each Fock state
+std::map<fock_state_t, int> block_of_states(atom_diag const& h_diag) {
+  std::map<fock_state_t, int> r;
+  auto fock_states = h_diag.get_fock_states();
+  for (int b = 0; b < h_diag.n_blocks(); ++b)
+    for (auto f : fock_states[b]) r[f] = b;
+  return r;
+}
+
+// The partition with quantum numbers is coarser than (or the same as) the autopartition, with the same spectrum
+void check_against_autopartition(many_body_op_t const& H, std::vector<many_body_op_t> const& qn) {
+  auto fops = make_fops();
+  atom_diag h_qn(H, fops, qn), h_auto(H, fops);
+
+  EXPECT_EQ(h_qn.get_full_hilbert_space_dim(), h_auto.get_full_hilbert_space_dim());
+  EXPECT_TRUE(h_qn.n_blocks() <= h_auto.n_blocks());
+  EXPECT_NEAR(h_qn.get_gs_energy(), h_auto.get_gs_energy(), 1.e-12);
+  auto s_qn = spectrum(h_qn), s_auto = spectrum(h_auto);
+  ASSERT_EQ(s_qn.size(), s_auto.size());
+  for (int i = 0; i < s_qn.size(); ++i) EXPECT_NEAR(s_qn[i], s_auto[i], 1.e-12);
+
+  // each block of the autopartition is in a single block of the quantum numbers
+  auto qn_block = block_of_states(h_qn);
+  auto fock_states = h_auto.get_fock_states();
+  for (int b = 0; b < h_auto.n_blocks(); ++b)
+    for (auto f : fock_states[b]) EXPECT_EQ(qn_block[f], qn_block[fock_states[b][0]]);
+}
+
+TEST(AtomDiag, PartitionWithQuantumNumbers) {
+  auto fops = make_fops();
+  auto bit = [&fops](std::string const& s, int o) { return fock_state_t(1) << fops[indices_t{s, o}]; };
+
+  // Density-density interaction without hopping : the occupations and their products are conserved
+  double U = 2.0, J = 0.3, ed0 = -1.1, ed1 = -0.9;
+  auto H = U * n("up", 0) * n("dn", 0) + U * n("up", 1) * n("dn", 1) + (U - 2 * J) * n("up", 0) * n("dn", 1) +
+           (U - 2 * J) * n("dn", 0) * n("up", 1) + (U - 3 * J) * (n("up", 0) * n("up", 1) + n("dn", 0) * n("dn", 1));
+  H += ed0 * (n("up", 0) + n("dn", 0)) + ed1 * (n("up", 1) + n("dn", 1));
+
+  // the quantum numbers, and their values on a Fock state from its bits
+  std::vector<many_body_op_t> qn{n("up", 0), n("dn", 0), n("up", 1), n("dn", 1), n("up", 0) * n("dn", 0),
+                                 0.5 * (n("up", 1) - n("dn", 1))};
+  auto qn_of_fock_state = [&bit](fock_state_t f) {
+    auto occ = [f, &bit](std::string const& s, int o) { return double((f & bit(s, o)) != 0); };
+    return std::vector<double>{occ("up", 0), occ("dn", 0), occ("up", 1), occ("dn", 1), occ("up", 0) * occ("dn", 0),
+                               0.5 * (occ("up", 1) - occ("dn", 1))};
+  };
+
+  atom_diag h_diag(H, fops, qn);
+  EXPECT_EQ(h_diag.n_blocks(), 16); // all the occupations are conserved
+  auto fock_states = h_diag.get_fock_states();
+  for (int b = 0; b < h_diag.n_blocks(); ++b) {
+    auto const& q = h_diag.get_quantum_numbers()[b];
+    for (auto f : fock_states[b]) {
+      auto expected = qn_of_fock_state(f);
+      ASSERT_EQ(q.size(), expected.size());
+      for (int i = 0; i < q.size(); ++i) EXPECT_NEAR(q[i], expected[i], 1.e-14);
+    }
+    // c and c^dagger flip one occupation
+    for (auto const& o : fops)
+      for (bool dagger : {false, true}) {
+        long bp = (dagger ? h_diag.cdag_connection(o.linear_index, b) : h_diag.c_connection(o.linear_index, b));
+        auto f = fock_states[b][0];
+        bool occupied = (f & (fock_state_t(1) << o.linear_index)) != 0;
+        if (occupied == dagger) {
+          EXPECT_EQ(bp, -1);
+          continue;
+        }
+        ASSERT_TRUE(bp != -1);
+        auto expected = qn_of_fock_state(f ^ (fock_state_t(1) << o.linear_index));
+        auto const& q_p = h_diag.get_quantum_numbers()[bp];
+        for (int i = 0; i < q_p.size(); ++i) EXPECT_NEAR(q_p[i], expected[i], 1.e-14);
+      }
+  }
+
+  check_against_autopartition(H, qn);
+
+  // With the hopping between the orbitals, only the number of electrons of each spin is conserved
+  auto H_hop = H + 0.7 * (c_dag("up", 0) * c("up", 1) + c_dag("up", 1) * c("up", 0) + c_dag("dn", 0) * c("dn", 1) +
+                          c_dag("dn", 1) * c("dn", 0));
+  check_against_autopartition(H_hop, {n("up", 0) + n("up", 1), n("dn", 0) + n("dn", 1)});
+  check_against_autopartition(H_hop, {n("up", 0) + n("up", 1) + n("dn", 0) + n("dn", 1),
+                                      0.5 * (n("up", 0) + n("up", 1) - n("dn", 0) - n("dn", 1))});
+}
+
+MAKE_MAIN;
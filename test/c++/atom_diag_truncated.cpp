@@ -0,0 +1,80 @@
+#include "atom_diag.hpp"
+#include "atom_diag_functions.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/test_tools/arrays.hpp>
+#include <tuple>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+
+TEST(AtomDiag, Truncated) {
+
+  fundamental_operator_set fops;
+  for (int o : {0, 1}) {
+    fops.insert("up", o);
+    fops.insert("dn", o);
+  }
+
+  // Two Hubbard orbitals with a hopping between them: blocks of dimension up to 4
+  double U = 2.0, ed0 = -1.1, ed1 = -0.9, V = 0.7;
+  auto H = U * n("up", 0) * n("dn", 0) + U * n("up", 1) * n("dn", 1);
+  H += ed0 * (n("up", 0) + n("dn", 0)) + ed1 * (n("up", 1) + n("dn", 1));
+  H += V * (c_dag("up", 0) * c("up", 1) + c_dag("up", 1) * c("up", 0) + c_dag("dn", 0) * c("dn", 1) +
+            c_dag("dn", 1) * c("dn", 0));
+
+  atom_diag h_diag(H, fops);
+  double beta = 10;
+  double z = partition_function(h_diag, beta);
+
+  for (double cutoff : {0.0, 0.5, 1.5, 3.0, 1.e10}) {
+    atom_diag t;
+    std::vector<int> block_map;
+    std::tie(t, block_map) = h_diag.truncated(cutoff);
+    ASSERT_EQ(int(block_map.size()), h_diag.n_blocks());
+
+    int n_kept_blocks = 0, n_kept_states = 0;
+    for (int B = 0; B < h_diag.n_blocks(); ++B) {
+      // the states of B below the cutoff, the first ones since the eigenvalues are sorted
+      int n_kept = 0;
+      for (int i = 0; i < h_diag.get_block_dim(B); ++i)
+        if (h_diag.get_eigenvalue(B, i) <= cutoff) ++n_kept;
+      if (n_kept == 0) {
+        EXPECT_EQ(block_map[B], -1);
+        continue;
+      }
+      int b = block_map[B];
+      ASSERT_EQ(b, n_kept_blocks); // the kept blocks are in the same order
+      ++n_kept_blocks;
+      n_kept_states += n_kept;
+      ASSERT_EQ(t.get_block_dim(b), n_kept);
+      for (int i = 0; i < n_kept; ++i) EXPECT_NEAR(t.get_eigenvalue(b, i), h_diag.get_eigenvalue(B, i), 1.e-14);
+
+      // the operators connect the same blocks, with the matrices restricted to the kept states
+      for (int op = 0; op < fops.size(); ++op)
+        for (bool dagger : {false, true}) {
+          long Bp = (dagger ? h_diag.cdag_connection(op, B) : h_diag.c_connection(op, B));
+          long bp = (dagger ? t.cdag_connection(op, b) : t.c_connection(op, b));
+          EXPECT_EQ(bp, (Bp == -1 ? -1 : block_map[Bp]));
+          if (bp == -1) continue;
+          auto const& M = (dagger ? h_diag.cdag_matrix(op, B) : h_diag.c_matrix(op, B));
+          auto const& m = (dagger ? t.cdag_matrix(op, b) : t.c_matrix(op, b));
+          EXPECT_ARRAY_NEAR(m, matrix_t(M(range(0, t.get_block_dim(bp)), range(0, n_kept))));
+        }
+    }
+    EXPECT_EQ(t.n_blocks(), n_kept_blocks);
+    EXPECT_EQ(t.get_full_hilbert_space_dim(), n_kept_states);
+
+    // the discarded states only remove their Boltzmann weights
+    double zt = partition_function(t, beta);
+    EXPECT_TRUE(zt <= z * (1 + 1.e-14));
+    if (cutoff > 100) {
+      EXPECT_EQ(n_kept_states, h_diag.get_full_hilbert_space_dim());
+      EXPECT_NEAR(zt, z, 1.e-12 * z);
+    }
+  }
+}
+
+MAKE_MAIN;
@@ -0,0 +1,54 @@
+#include "batch_error.hpp"
+#include <triqs/test_tools/arrays.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace cthyb;
+
+// Gaussian random numbers (Box-Muller on the raw output of mt19937, the same on all platforms)
+struct gaussian {
+  std::mt19937 gen;
+  gaussian(unsigned seed) : gen(seed) {}
+  double operator()() {
+    double u1 = (gen() + 0.5) / 4294967296.0, u2 = (gen() + 0.5) / 4294967296.0;
+    return std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+  }
+};
+
+// Batches of very different sizes, i.e. of different weights z, of measurements of an AR(1) series
+// x_{t+1} = phi x_t + sqrt(1 - phi^2) eps_t, of variance 1 and integrated autocorrelation time (1 + phi) / (1 - phi) / 2.
+// The error of the mean is then sqrt(2 * tau / n).
+TEST(BatchError, AR1) {
+  triqs::mpi::communicator world;
+  gaussian eps(3);
+  std::mt19937 gen(4);
+  double phi = 0.8, tau = (1 + phi) / (1 - phi) / 2;
+
+  batch_error_estimator est(1);
+  arrays::vector<double> sum(1);
+  sum() = 0;
+  double x = eps();
+  long n = 0;
+  for (int b = 0; b < 400; ++b) {
+    long batch_size = 200 + gen() % 20000;
+    for (long t = 0; t < batch_size; ++t, ++n) {
+      sum(0) += x;
+      x = phi * x + std::sqrt(1 - phi * phi) * eps();
+    }
+    est.add_batch(sum, n);
+    if (b + 1 < batch_error_estimator::min_batches)
+      EXPECT_EQ(est.max_error(world), std::numeric_limits<double>::infinity());
+  }
+
+  // The estimate of the error from 400 batches has a relative error of ~ 1 / sqrt(2 * 400) ~ 4%
+  double error = std::sqrt(2 * tau / n);
+  EXPECT_NEAR(est.max_error(world), error, 0.15 * error);
+
+  // No measurement : the batch is ignored
+  auto e = est.max_error(world);
+  est.add_batch(sum, n);
+  EXPECT_EQ(est.max_error(world), e);
+}
+
+MAKE_MAIN;
@@ -0,0 +1,62 @@
+#include "binning.hpp"
+#include <triqs/test_tools/arrays.hpp>
+#include <cmath>
+#include <random>
+
+using namespace cthyb;
+
+// Gaussian random numbers (Box-Muller on the raw output of mt19937, the same on all platforms)
+struct gaussian {
+  std::mt19937 gen;
+  gaussian(unsigned seed) : gen(seed) {}
+  double operator()() {
+    double u1 = (gen() + 0.5) / 4294967296.0, u2 = (gen() + 0.5) / 4294967296.0;
+    return std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+  }
+};
+
+// x_{t+1} = phi x_t + sqrt(1 - phi^2) eps_t : mean 0, variance 1,
+// integrated autocorrelation time (1 + phi) / (1 - phi) / 2
+log_binning ar1_series(double phi, long size, unsigned seed) {
+  gaussian eps(seed);
+  log_binning b;
+  double x = eps();
+  for (long t = 0; t < size; ++t) {
+    b << x;
+    x = phi * x + std::sqrt(1 - phi * phi) * eps();
+  }
+  return b;
+}
+
+// The estimates come from the last level with at least log_binning::min_bins bins, hence a relative error of about
+// 1 / sqrt(2 * min_bins) ~ 9% on the error, twice more on the autocorrelation time : the tolerances are ~4 sigma.
+
+TEST(Binning, WhiteNoise) {
+  long size = 1 << 16;
+  auto b = ar1_series(0, size, 1);
+  EXPECT_EQ(b.size(), size);
+  EXPECT_NEAR(b.autocorrelation_time(), 0.5, 0.4);
+  EXPECT_NEAR(b.error(), 1 / std::sqrt(size), 0.35 / std::sqrt(size));
+  EXPECT_NEAR(b.mean(), 0, 4 * b.error());
+}
+
+TEST(Binning, AR1) {
+  long size = 1 << 20;
+  for (double phi : {0.5, 0.8, 0.95}) {
+    auto b = ar1_series(phi, size, 2);
+    double tau = (1 + phi) / (1 - phi) / 2, error = std::sqrt(2 * tau / size);
+    EXPECT_NEAR(b.autocorrelation_time(), tau, 0.7 * tau);
+    EXPECT_NEAR(b.error(), error, 0.35 * error);
+    EXPECT_NEAR(b.mean(), 0, 4 * error);
+  }
+}
+
+TEST(Binning, Constant) {
+  log_binning b;
+  for (int t = 0; t < 1000; ++t) b << 3.0;
+  EXPECT_NEAR(b.mean(), 3.0, 1.e-14);
+  EXPECT_NEAR(b.error(), 0, 1.e-14);
+  EXPECT_NEAR(b.autocorrelation_time(), 0.5, 1.e-14);
+}
+
+MAKE_MAIN;
@@ -0,0 +1,72 @@
+#include "solver_core.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/gfs.hpp>
+#include <triqs/test_tools/gfs.hpp>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+using namespace triqs::gfs;
+using indices_type = triqs::operators::indices_t;
+
+// The Anderson model of anderson.cpp (with BLOCK), solved with n_chains chains and the seed random_seed for the first one
+block_gf<imtime> solve_anderson(int n_chains, int random_seed) {
+
+  double beta = 10.0;
+  double U = 2.0;
+  double mu = 1.0;
+  double h = 0.0;
+  double V = 1.0;
+  double epsilon = 2.3;
+
+  std::map<std::string, indices_type> gf_struct{{"up", {0}}, {"down", {0}}};
+  auto H = U * n("up", 0) * n("down", 0) + h * n("up", 0) - h * n("down", 0);
+
+  solver_core solver(beta, gf_struct, 1025, 2500);
+
+  triqs::clef::placeholder<0> om_;
+  auto g0_iw = gf<imfreq>{{beta, Fermion}, {1, 1}};
+  g0_iw(om_) << om_ + mu - (V * V / (om_ - epsilon) + V * V / (om_ + epsilon));
+  for (int bl = 0; bl < 2; ++bl) solver.G0_iw()[bl] = triqs::gfs::inverse(g0_iw);
+
+  auto p = solve_parameters_t(H, 5000);
+  p.random_name = "";
+  p.random_seed = random_seed;
+  p.max_time = -1;
+  p.length_cycle = 50;
+  p.n_warmup_cycles = 50;
+  p.move_double = false;
+  p.n_chains = n_chains;
+
+  solver.solve(p);
+  return block_gf<imtime>(solver.G_tau());
+}
+
+TEST(CtHyb, Chains) {
+
+  int rank = triqs::mpi::communicator().rank();
+  int seed = 123 * rank + 567;
+
+  // One chain : the same run as anderson_block
+  auto g1 = solve_anderson(1, seed);
+  if (rank == 0) {
+    gf<imtime> g;
+    triqs::h5::file G_file("anderson_block.ref.h5", 'r');
+    h5_read(G_file, "G_up", g);
+    EXPECT_GF_NEAR(g, g1[0]);
+    h5_read(G_file, "G_down", g);
+    EXPECT_GF_NEAR(g, g1[1]);
+  }
+
+  // Two chains : the second one has the seed of the first one + 1009, and the same number of measures.
+  // The sign is always 1, so that the result is the average of the two single chain runs.
+  auto g2 = solve_anderson(2, seed);
+  auto g1_next = solve_anderson(1, seed + 1009);
+  for (int bl = 0; bl < 2; ++bl) {
+    array<dcomplex, 3> average = 0.5 * (g1[bl].data() + g1_next[bl].data());
+    EXPECT_ARRAY_NEAR(g2[bl].data(), average, 1.e-12);
+  }
+}
+MAKE_MAIN;
@@ -0,0 +1,58 @@
+#include "det_positions.hpp"
+#include <triqs/test_tools/arrays.hpp>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace cthyb;
+using triqs::utility::time_segment;
+
+// The part of the interface of det_manip used by det_positions : the operators in decreasing time order
+struct mock_det {
+  std::vector<std::pair<time_pt, int>> x, y; // c^dagger and c
+  int size() const { return x.size(); }
+  std::pair<time_pt, int> const& get_x(int i) const { return x[i]; }
+  std::pair<time_pt, int> const& get_y(int i) const { return y[i]; }
+};
+
+TEST(DetPositions, Bisection) {
+  double beta = 10;
+  time_segment tau_seg(beta);
+  std::mt19937 gen(1234);
+  std::uniform_real_distribution<double> random_tau(0, beta);
+  auto random_pt = [&]() { return tau_seg.make_time_pt(random_tau(gen)); };
+  auto later = [](std::pair<time_pt, int> const& a, std::pair<time_pt, int> const& b) { return a.first > b.first; };
+
+  for (int size : {0, 1, 2, 3, 7, 16, 33, 100}) {
+    mock_det det;
+    for (int i = 0; i < size; ++i) {
+      det.x.push_back({random_pt(), i});
+      det.y.push_back({random_pt(), i});
+    }
+    std::sort(det.x.begin(), det.x.end(), later);
+    std::sort(det.y.begin(), det.y.end(), later);
+
+    for (bool dagger : {true, false}) {
+      auto const& ops = (dagger ? det.x : det.y);
+      // random times, and the times of the operators themselves
+      std::vector<time_pt> taus;
+      for (int n = 0; n < 50; ++n) taus.push_back(random_pt());
+      for (auto const& op : ops) taus.push_back(op.first);
+
+      for (auto const& tau : taus) {
+        // the number of operators at times >= tau (an operator at tau itself is counted), by a linear search
+        int n_not_before =
+            std::count_if(ops.begin(), ops.end(), [&tau](std::pair<time_pt, int> const& op) { return !(op.first < tau); });
+        EXPECT_EQ(det_position(det, dagger, tau), n_not_before);
+        // the number of operators at times > tau
+        int n_after =
+            std::count_if(ops.begin(), ops.end(), [&tau](std::pair<time_pt, int> const& op) { return op.first > tau; });
+        EXPECT_EQ(det_partition_point(det, dagger, [&tau](time_pt const& t) { return !(t > tau); }), n_after);
+      }
+    }
+  }
+}
+
+MAKE_MAIN;
@@ -0,0 +1,129 @@
+#include "solver_core.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/gfs.hpp>
+#include <triqs/test_tools/gfs.hpp>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+using namespace triqs::gfs;
+using indices_type = triqs::operators::indices_t;
+
+double beta = 10.0;
+int n_blocks = 2, n_f = 4, n_b = 3;
+
+struct g2_run {
+  std::vector<array<dcomplex, 7>> g2;
+  std::vector<std::map<int, dcomplex>> g_iw; // [block][Matsubara index n]
+};
+
+// The Anderson model of anderson.cpp, without interaction and in a magnetic field h : the impurity is Gaussian
+g2_run solve_anderson(int random_seed) {
+
+  double mu = 1.0;
+  double h = 0.3;
+  double V = 1.0;
+  double epsilon = 2.3;
+
+  std::map<std::string, indices_type> gf_struct{{"up", {0}}, {"down", {0}}};
+  auto H = h * n("up", 0) - h * n("down", 0);
+
+  solver_core solver(beta, gf_struct, 1025, 2500);
+
+  triqs::clef::placeholder<0> om_;
+  auto g0_iw = gf<imfreq>{{beta, Fermion}, {1, 1}};
+  g0_iw(om_) << om_ + mu - (V * V / (om_ - epsilon) + V * V / (om_ + epsilon));
+  for (int bl = 0; bl < 2; ++bl) solver.G0_iw()[bl] = triqs::gfs::inverse(g0_iw);
+
+  auto p = solve_parameters_t(H, 4000);
+  p.random_name = "";
+  p.random_seed = random_seed;
+  p.max_time = -1;
+  p.length_cycle = 50;
+  p.n_warmup_cycles = 50;
+  p.move_double = false;
+  p.measure_g_tau = false;
+  p.measure_g_iw = true;
+  p.measure_g2 = true;
+  p.g2_n_fermionic = n_f;
+  p.g2_n_bosonic = n_b;
+  p.n_g2_threads = 2;
+
+  solver.solve(p);
+
+  // G(iw_n) by Matsubara index, with G(-iw_n) = G(iw_n)^* if the mesh has only the positive frequencies
+  g2_run r{solver.G2_iw(), std::vector<std::map<int, dcomplex>>(n_blocks)};
+  for (int bl = 0; bl < n_blocks; ++bl) {
+    auto g = solver.G_iw_measured()[bl];
+    for (auto const& iw : g.mesh()) {
+      int n = int(std::lround((dcomplex(iw).imag() * beta / M_PI - 1) / 2));
+      r.g_iw[bl][n] = g[iw](0, 0);
+      if (!r.g_iw[bl].count(-n - 1)) r.g_iw[bl][-n - 1] = std::conj(g[iw](0, 0));
+    }
+  }
+  return r;
+}
+
+TEST(CtHyb, G2) {
+
+  // Initialize mpi
+  int rank = triqs::mpi::communicator().rank();
+  int seed = 123 * rank + 567;
+
+  // Two independent runs : their difference gives the scale of the statistical error
+  auto run1 = solve_anderson(seed);
+  auto run2 = solve_anderson(seed + 1009);
+  ASSERT_EQ(run1.g2.size(), n_blocks * n_blocks);
+
+  double g2_max = 0;
+  for (auto const& g : run1.g2) g2_max = std::max(g2_max, max_element(abs(g)));
+  EXPECT_TRUE(g2_max > 0);
+
+  // Symmetries of the estimator, exact for each measure :
+  //  - the exchange of the two pairs of operators : G2^{AB}_{abcd}(0, w, w') = G2^{BA}_{cdab}(0, w', w)
+  //  - the dets are real : G2(0, w, w')^* = G2(0, -w, -w'), with -w_n = w_{-n-1} at the array index 2 n_f - 1 - w
+  double tol = 1.e-10 * g2_max;
+  for (int A = 0; A < n_blocks; ++A)
+    for (int B = 0; B < n_blocks; ++B) {
+      auto const& g_AB = run1.g2[A * n_blocks + B];
+      auto const& g_BA = run1.g2[B * n_blocks + A];
+      for (int w = 0; w < 2 * n_f; ++w)
+        for (int wp = 0; wp < 2 * n_f; ++wp) {
+          dcomplex x = g_AB(0, w, wp, 0, 0, 0, 0);
+          EXPECT_NEAR(std::abs(x - g_BA(0, wp, w, 0, 0, 0, 0)), 0, tol);
+          EXPECT_NEAR(std::abs(std::conj(x) - g_AB(0, 2 * n_f - 1 - w, 2 * n_f - 1 - wp, 0, 0, 0, 0)), 0, tol);
+        }
+    }
+
+  // Without interaction, Wick's theorem with the measured G(iw) of the two runs :
+  //  G2^{AB}(W, w, w') = beta G_A(w) G_B(w') delta_{W,0} - delta_{AB} beta G_A(w) G_A(w + W) delta_{w,w'}
+  // for all the bosonic frequencies, within twice the largest difference of the two runs on each (A, B, W)
+  auto G = [&](int bl, int n) { return 0.5 * (run1.g_iw[bl].at(n) + run2.g_iw[bl].at(n)); };
+  for (int A = 0; A < n_blocks; ++A)
+    for (int B = 0; B < n_blocks; ++B)
+      for (int W = 0; W < n_b; ++W) {
+        auto const& g_1 = run1.g2[A * n_blocks + B];
+        auto const& g_2 = run2.g2[A * n_blocks + B];
+        double error = 0, wick_max = 0;
+        for (int w = 0; w < 2 * n_f; ++w)
+          for (int wp = 0; wp < 2 * n_f; ++wp)
+            error = std::max(error, std::abs(g_1(W, w, wp, 0, 0, 0, 0) - g_2(W, w, wp, 0, 0, 0, 0)));
+        EXPECT_TRUE(error > 0);
+
+        for (int w = 0; w < 2 * n_f; ++w)
+          for (int wp = 0; wp < 2 * n_f; ++wp) {
+            int n1 = w - n_f, n2 = wp - n_f; // Matsubara indices of w and w'
+            dcomplex wick = 0;
+            if (W == 0) wick += beta * G(A, n1) * G(B, n2);
+            if ((A == B) && (w == wp)) wick -= beta * G(A, n1) * G(A, n1 + W);
+            wick_max = std::max(wick_max, std::abs(wick));
+            dcomplex g2_average = 0.5 * (g_1(W, w, wp, 0, 0, 0, 0) + g_2(W, w, wp, 0, 0, 0, 0));
+            EXPECT_NEAR(std::abs(g2_average - wick), 0, 2 * error);
+          }
+        // the reference vanishes for A != B at W > 0, elsewhere it is not hidden by the error
+        if ((W == 0) || (A == B)) EXPECT_TRUE(wick_max > 2 * error);
+      }
+}
+MAKE_MAIN;
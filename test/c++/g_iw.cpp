@@ -0,0 +1,67 @@
+#include "solver_core.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/gfs.hpp>
+#include <triqs/test_tools/gfs.hpp>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+using namespace triqs::gfs;
+using indices_type = triqs::operators::indices_t;
+
+TEST(CtHyb, G_iw) {
+
+  // Initialize mpi
+  int rank = triqs::mpi::communicator().rank();
+
+  // The Anderson model of anderson.cpp
+  double beta = 10.0;
+  double U = 2.0;
+  double mu = 1.0;
+  double h = 0.0;
+  double V = 1.0;
+  double epsilon = 2.3;
+  int n_iw = 1025;
+
+  std::map<std::string, indices_type> gf_struct{{"up", {0}}, {"down", {0}}};
+  auto H = U * n("up", 0) * n("down", 0) + h * n("up", 0) - h * n("down", 0);
+
+  solver_core solver(beta, gf_struct, n_iw, 2500);
+
+  triqs::clef::placeholder<0> om_;
+  auto g0_iw = gf<imfreq>{{beta, Fermion}, {1, 1}};
+  g0_iw(om_) << om_ + mu - (V * V / (om_ - epsilon) + V * V / (om_ + epsilon));
+  for (int bl = 0; bl < 2; ++bl) solver.G0_iw()[bl] = triqs::gfs::inverse(g0_iw);
+
+  int n_cycles = 5000;
+  auto p = solve_parameters_t(H, n_cycles);
+  p.random_name = "";
+  p.random_seed = 123 * rank + 567;
+  p.max_time = -1;
+  p.length_cycle = 50;
+  p.n_warmup_cycles = 50;
+  p.move_double = false;
+  p.measure_g_tau = true;
+  p.measure_g_iw = true;
+
+  solver.solve(p);
+
+  // G(iw) measured directly and the Fourier transform of G(tau) come from the same configurations: they differ only by
+  // the binning of G(tau) on the tau mesh and the error of the transform, small at low frequencies
+  for (int bl = 0; bl < 2; ++bl) {
+    auto g_ft = gf<imfreq>{{beta, Fermion, n_iw}, {1, 1}};
+    g_ft() = fourier(solver.G_tau()[bl]);
+    auto g_measured = solver.G_iw_measured()[bl];
+    int n_compared = 0;
+    for (auto const& iw : g_ft.mesh()) {
+      dcomplex w = iw;
+      if (std::abs(w.imag()) > 40 * M_PI / beta) continue; // |n| < 20
+      EXPECT_NEAR(std::abs(g_measured[iw](0, 0) - g_ft[iw](0, 0)), 0, 5.e-3);
+      ++n_compared;
+    }
+    EXPECT_TRUE(n_compared >= 20);
+  }
+}
+MAKE_MAIN;
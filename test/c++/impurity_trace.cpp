@@ -0,0 +1,222 @@
+#include "impurity_trace.hpp"
+#include <triqs/operators/many_body_operator.hpp>
+#include <triqs/hilbert_space/fundamental_operator_set.hpp>
+#include <triqs/test_tools/arrays.hpp>
+#include <random>
+
+using namespace cthyb;
+using triqs::operators::c;
+using triqs::operators::c_dag;
+using triqs::operators::n;
+
+// The matrix of c or c^dagger on the full Hilbert space, in the eigenbasis of h_diag
+matrix_t full_matrix(atom_diag const& h_diag, long linear_index, bool dagger) {
+  int dim = h_diag.get_full_hilbert_space_dim();
+  std::vector<int> offset(h_diag.n_blocks() + 1, 0);
+  for (int B = 0; B < h_diag.n_blocks(); ++B) offset[B + 1] = offset[B] + h_diag.get_block_dim(B);
+  matrix_t r(dim, dim);
+  r() = 0;
+  for (int B = 0; B < h_diag.n_blocks(); ++B) {
+    long Bp = (dagger ? h_diag.cdag_connection(linear_index, B) : h_diag.c_connection(linear_index, B));
+    if (Bp == -1) continue;
+    auto const& m = (dagger ? h_diag.cdag_matrix(linear_index, B) : h_diag.c_matrix(linear_index, B));
+    r(range(offset[Bp], offset[Bp + 1]), range(offset[B], offset[B + 1])) = m;
+  }
+  return r;
+}
+
+// exp(-dtau H) on the full Hilbert space, in the eigenbasis of h_diag
+matrix_t full_evolution(atom_diag const& h_diag, double dtau) {
+  int dim = h_diag.get_full_hilbert_space_dim();
+  matrix_t r(dim, dim);
+  r() = 0;
+  int i = 0;
+  for (int B = 0; B < h_diag.n_blocks(); ++B)
+    for (int u = 0; u < h_diag.get_block_dim(B); ++u, ++i) r(i, i) = std::exp(-dtau * h_diag.get_eigenvalue(B, u));
+  return r;
+}
+
+// Tr[ e^{-(beta - tau_0) H} O_0 e^{-(tau_0 - tau_1) H} O_1 ... O_{n-1} e^{-tau_{n-1} H} ] with dense matrices,
+// for the operators of the configuration in decreasing time order
+h_scalar_t brute_force_trace(atom_diag const& h_diag, configuration const& config) {
+  double beta = config.beta(), tau_prev = beta;
+  matrix_t r = full_evolution(h_diag, 0);
+  for (auto const& x : config) {
+    double tau = double(x.first);
+    r = r * full_evolution(h_diag, tau_prev - tau) * full_matrix(h_diag, x.second.linear_index, x.second.dagger);
+    tau_prev = tau;
+  }
+  r = r * full_evolution(h_diag, tau_prev);
+  h_scalar_t tr = 0;
+  for (int i = 0; i < first_dim(r); ++i) tr += r(i, i);
+  return tr;
+}
+
+// Two Hubbard orbitals with a hopping between them
+fundamental_operator_set make_fops() {
+  fundamental_operator_set fops;
+  for (int o : {0, 1}) {
+    fops.insert("up", o);
+    fops.insert("dn", o);
+  }
+  return fops;
+}
+
+atom_diag make_h_diag() {
+  double U = 2.0, ed0 = -1.1, ed1 = -0.9, V = 0.7;
+  auto H = U * n("up", 0) * n("dn", 0) + U * n("up", 1) * n("dn", 1);
+  H += ed0 * (n("up", 0) + n("dn", 0)) + ed1 * (n("up", 1) + n("dn", 1));
+  H += V * (c_dag("up", 0) * c("up", 1) + c_dag("up", 1) * c("up", 0) + c_dag("dn", 0) * c("dn", 1) +
+            c_dag("dn", 1) * c("dn", 0));
+  return atom_diag(H, make_fops());
+}
+
+// The spin is the block index, the orbital the inner index
+op_desc make_op(int s, int o, bool dagger) {
+  return op_desc{s, o, dagger, make_fops()[indices_t{std::string(s == 0 ? "up" : "dn"), o}]};
+}
+
+// Random insertions and removals of pairs c^dagger c of the same spin, each one tried then confirmed or cancelled,
+// and the trace of each trial and each new configuration compared to the brute force one.
+// With n_move_windows > 1, the trace is computed in the window mode : most insertions are in the window, which slides
+// from time to time, the removals and the other insertions are anywhere.
+void check_random_moves(int n_trace_threads, int n_move_windows = 1) {
+
+  auto h_diag = make_h_diag();
+  double beta = 5;
+  configuration config(beta);
+  time_segment tau_seg(beta);
+  solve_parameters_t p;
+  p.n_trace_threads = n_trace_threads;
+  p.n_move_windows = n_move_windows;
+  if (n_move_windows > 1) p.trace_method = "window";
+  sliding_window window(beta, tau_seg, n_move_windows);
+  impurity_trace imp_trace(config, h_diag, p, nullptr, &window);
+
+  auto n_ops = [&config](int s, bool dagger) {
+    int r = 0;
+    for (auto const& x : config) r += (x.second.block_index == s && x.second.dagger == dagger);
+    return r;
+  };
+
+  // The trace is at most of the order of the partition function, which is larger than 1
+  double tol = 1.e-11 * partition_function(h_diag, beta);
+  auto check = [&](configuration const& c) {
+    EXPECT_NEAR(std::abs(imp_trace.compute().first - brute_force_trace(h_diag, c)), 0, tol);
+  };
+
+  EXPECT_NEAR(std::abs(imp_trace.compute().first - partition_function(h_diag, beta)), 0, tol);
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> uniform(0, beta);
+  auto random_time = [&]() {
+    if ((n_move_windows == 1) || (gen() % 4 == 0)) return tau_seg.make_time_pt(uniform(gen));
+    return tau_seg.make_time_pt(double(window.get_lower()) + uniform(gen) * window.width() / beta);
+  };
+  for (int step = 0; step < 300; ++step) {
+    int s = gen() % 2;
+    bool confirm = gen() % 2;
+    auto trial = config;
+    if ((n_move_windows > 1) && (gen() % 4 == 0)) window.slide();
+
+    if (config.size() < 2 || (config.size() < 16 && gen() % 2)) {
+      auto tau1 = random_time(), tau2 = random_time();
+      auto op1 = make_op(s, gen() % 2, true), op2 = make_op(s, gen() % 2, false);
+      trial.insert(tau1, op1);
+      trial.insert(tau2, op2);
+      if (trial.size() != config.size() + 2) continue; // two equal times
+      imp_trace.try_insert(tau1, op1);
+      imp_trace.try_insert(tau2, op2);
+      check(trial);
+      if (confirm) {
+        imp_trace.confirm_insert();
+        config = trial;
+      } else
+        imp_trace.cancel_insert();
+    } else {
+      int n_c = n_ops(s, false), n_c_dag = n_ops(s, true);
+      if (n_c == 0 || n_c_dag == 0) continue;
+      auto tau1 = imp_trace.try_delete(gen() % n_c, s, false);
+      auto tau2 = imp_trace.try_delete(gen() % n_c_dag, s, true);
+      trial.erase(tau1);
+      trial.erase(tau2);
+      ASSERT_EQ(trial.size(), config.size() - 2);
+      check(trial);
+      if (confirm) {
+        imp_trace.confirm_delete();
+        config = trial;
+      } else
+        imp_trace.cancel_delete();
+    }
+
+    // the trace of the current configuration, from the cached products of the unmodified tree
+    check(config);
+    int k = 0;
+    for (auto const& x : config) EXPECT_EQ(double(imp_trace.get_nth_operator(k++).first), double(x.first));
+  }
+}
+
+TEST(ImpurityTrace, BruteForce) { check_random_moves(1); }
+
+TEST(ImpurityTrace, BruteForceThreads) { check_random_moves(3); }
+
+TEST(ImpurityTrace, BruteForceWindow) { check_random_moves(1, 4); }
+
+TEST(ImpurityTrace, BruteForceWindowThreads) { check_random_moves(3, 4); }
+
+// Shifts of one operator change the distances between the nodes without changing the structure of the tree :
+// the cached time evolution vectors of the nodes must follow
+TEST(ImpurityTrace, Shift) {
+
+  auto h_diag = make_h_diag();
+  double beta = 5;
+  configuration config(beta);
+  time_segment tau_seg(beta);
+  solve_parameters_t p;
+  impurity_trace imp_trace(config, h_diag, p, nullptr);
+  double tol = 1.e-11 * partition_function(h_diag, beta);
+
+  std::mt19937 gen(2);
+  std::uniform_real_distribution<double> uniform(0, beta);
+  for (int s : {0, 1})
+    for (int o : {0, 1})
+      for (bool dagger : {false, true}) {
+        auto tau = tau_seg.make_time_pt(uniform(gen));
+        auto op = make_op(s, o, dagger);
+        config.insert(tau, op);
+        imp_trace.try_insert(tau, op);
+        imp_trace.confirm_insert();
+      }
+  ASSERT_EQ(config.size(), 8);
+  EXPECT_NEAR(std::abs(imp_trace.compute().first - brute_force_trace(h_diag, config)), 0, tol);
+
+  for (int step = 0; step < 200; ++step) {
+    // the k-th operator of the configuration, and its position among the operators of its kind
+    int k = gen() % config.size(), n = 0;
+    time_pt tau_old;
+    op_desc op;
+    std::tie(tau_old, op) = imp_trace.get_nth_operator(k);
+    for (auto const& x : config) {
+      if (x.first == tau_old) break;
+      n += (x.second.block_index == op.block_index && x.second.dagger == op.dagger);
+    }
+    auto tau_new = tau_seg.make_time_pt(uniform(gen));
+
+    auto trial = config;
+    trial.erase(tau_old);
+    trial.insert(tau_new, op);
+    if (trial.size() != config.size()) continue; // two equal times
+
+    EXPECT_TRUE(imp_trace.try_delete(n, op.block_index, op.dagger) == tau_old);
+    imp_trace.try_insert(tau_new, op);
+    EXPECT_NEAR(std::abs(imp_trace.compute().first - brute_force_trace(h_diag, trial)), 0, tol);
+    if (gen() % 2) {
+      imp_trace.confirm_shift();
+      config = trial;
+    } else
+      imp_trace.cancel_shift();
+    EXPECT_NEAR(std::abs(imp_trace.compute().first - brute_force_trace(h_diag, config)), 0, tol);
+  }
+}
+
+MAKE_MAIN;
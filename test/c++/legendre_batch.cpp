@@ -0,0 +1,32 @@
+#include "legendre_batch.hpp"
+#include <triqs/utility/legendre.hpp>
+#include <triqs/test_tools/arrays.hpp>
+#include <random>
+
+using namespace cthyb;
+
+// The sums over a batch against the Legendre generator, one pair at a time
+TEST(LegendreBatch, Generator) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  for (int n_l : {1, 2, 3, 50})
+    for (int n : {1, 7, 8, 9, 100}) {
+      legendre_batch<double> batch(n_l);
+      // twice, to check that take resets the sums
+      for (int repeat = 0; repeat < 2; ++repeat) {
+        std::vector<double> xs(n), vs(n), expected(n_l, 0);
+        for (auto& x : xs) x = uniform(gen);
+        xs[0] = (repeat == 0 ? 1 : -1);
+        for (auto& v : vs) v = uniform(gen);
+        triqs::utility::legendre_generator Tn;
+        for (int c = 0; c < n; ++c) {
+          Tn.reset(xs[c]);
+          for (int l = 0; l < n_l; ++l) expected[l] += vs[c] * Tn.next();
+        }
+        batch.add(xs, vs);
+        for (int l = 0; l < n_l; ++l) EXPECT_NEAR(batch.take(l), expected[l], 1.e-12 * n);
+      }
+    }
+}
+
+MAKE_MAIN;
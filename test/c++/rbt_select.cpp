@@ -0,0 +1,62 @@
+#include <triqs/utility/rbt.hpp>
+#include <triqs/test_tools/arrays.hpp>
+#include <random>
+#include <set>
+#include <utility>
+
+// A value which summarizes its subtree, like the per-(block, dagger) counts of the nodes of the trace
+struct counted {
+  int value = 0;
+  int n_even = 0; // number of even values in the subtree
+  counted(int value = 0) : value(value) {}
+  void update_subtree(counted const* l, counted const* r) {
+    n_even = (value % 2 == 0) + (l ? l->n_even : 0) + (r ? r->n_even : 0);
+  }
+};
+
+using tree_t = triqs::utility::rb_tree<int, counted>;
+
+// Recompute the count and the number of even values of the subtree of n, and compare them with the ones of the nodes
+std::pair<int, int> check_subtree(tree_t::node n) {
+  if (n == nullptr) return {0, 0};
+  auto l = check_subtree(n->left), r = check_subtree(n->right);
+  std::pair<int, int> res = {l.first + r.first + 1, l.second + r.second + (n->value % 2 == 0)};
+  EXPECT_EQ(n->N, res.first);
+  EXPECT_EQ(n->n_even, res.second);
+  return res;
+}
+
+TEST(RbTree, SubtreeCountsAndSelect) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> random_key(0, 299);
+  tree_t tree;
+  std::set<int> keys;
+
+  for (int step = 0; step < 3000; ++step) {
+    // insertions and deletions at random, the tree growing in the first half and shrinking in the second one
+    int key = random_key(gen);
+    bool grow = (step < 1500);
+    if (keys.count(key) == 0) {
+      if (!grow && !keys.empty() && (gen() % 4 != 0)) continue;
+      tree.insert(key, counted(key * 7));
+      keys.insert(key);
+    } else {
+      if (grow && (gen() % 4 != 0)) continue;
+      tree.delete_node(key);
+      keys.erase(key);
+    }
+
+    ASSERT_EQ(tree.size(), int(keys.size()));
+    check_subtree(tree.get_root());
+
+    // select_node follows the order of the keys
+    int k = 0;
+    for (int x : keys) {
+      auto n = tree.select_node(k++);
+      EXPECT_EQ(n->key, x);
+      EXPECT_EQ(n->value, x * 7);
+    }
+  }
+}
+
+MAKE_MAIN;
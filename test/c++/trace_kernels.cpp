@@ -0,0 +1,118 @@
+#include "trace_kernels.hpp"
+#include <triqs/test_tools/arrays.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace cthyb;
+
+using buffer_t = std::vector<h_scalar_t>;
+
+// Random row-major n1 x n2 matrix
+buffer_t random_matrix(int n1, int n2, std::mt19937& gen) {
+  std::uniform_real_distribution<double> dist(-1, 1);
+  buffer_t m(long(n1) * n2);
+  for (auto& x : m) x = dist(gen);
+  return m;
+}
+
+// A * diag(d) * B (A : n1 x k, B : k x n2) from the definition, diag(d) = 1 if d is empty
+buffer_t naive_product(int n1, int n2, int k, buffer_t const& A, std::vector<double> const& d, buffer_t const& B) {
+  buffer_t C(long(n1) * n2, 0);
+  for (int i = 0; i < n1; ++i)
+    for (int j = 0; j < n2; ++j)
+      for (int u = 0; u < k; ++u) C[i * n2 + j] += A[i * k + u] * (d.empty() ? 1.0 : d[u]) * B[u * n2 + j];
+  return C;
+}
+
+double max_difference(buffer_t const& a, buffer_t const& b) {
+  double r = 0;
+  for (long i = 0; i < long(a.size()); ++i) r = std::max(r, double(std::abs(a[i] - b[i])));
+  return r;
+}
+
+// The dimensions of the products : all the remainders of the 4-row blocking of small_gemm
+std::vector<int> dims = {1, 2, 3, 4, 5, 6, 7, 8, 9, 13};
+
+TEST(TraceKernels, SmallGemm) {
+  std::mt19937 gen(123);
+  for (int n1 : dims)
+    for (int n2 : dims)
+      for (int k : dims) {
+        auto A = random_matrix(n1, k, gen), B = random_matrix(k, n2, gen);
+        buffer_t C(long(n1) * n2);
+        kernels::small_gemm(n1, n2, k, A.data(), B.data(), C.data());
+        EXPECT_LT(max_difference(C, naive_product(n1, n2, k, A, {}, B)), 1.e-13);
+      }
+}
+
+TEST(TraceKernels, Gemm) {
+  std::mt19937 gen(456);
+  // the first product is done by small_gemm, the others by BLAS (above kernels::small_product_size)
+  for (auto n : std::vector<std::array<int, 3>>{{{7, 9, 5}}, {{40, 33, 35}}, {{33, 1, 1500}}, {{50, 50, 50}}}) {
+    auto A = random_matrix(n[0], n[2], gen), B = random_matrix(n[2], n[1], gen);
+    buffer_t C(long(n[0]) * n[1]);
+    kernels::gemm(n[0], n[1], n[2], A.data(), B.data(), C.data());
+    EXPECT_LT(max_difference(C, naive_product(n[0], n[1], n[2], A, {}, B)), 1.e-12);
+  }
+}
+
+// Random diagonal of a time evolution
+std::vector<double> random_diagonal(int k, std::mt19937& gen) {
+  std::uniform_real_distribution<double> dist(0, 1);
+  std::vector<double> d(k);
+  for (auto& x : d) x = dist(gen);
+  return d;
+}
+
+TEST(TraceKernels, ScaledGemm) {
+  std::mt19937 gen(789);
+  // k <= 8 : scaled_gemm_fixed<k>, above : scaled_gemm_generic
+  for (int k = 1; k <= 12; ++k)
+    for (int n1 : dims)
+      for (int n2 : dims) {
+        auto A = random_matrix(n1, k, gen), B = random_matrix(k, n2, gen);
+        auto d = random_diagonal(k, gen);
+        buffer_t C(long(n1) * n2), work(long(n1) * k);
+        kernels::scaled_gemm_for_dim(k)(n1, n2, k, A.data(), d.data(), B.data(), C.data(), work.data());
+        EXPECT_LT(max_difference(C, naive_product(n1, n2, k, A, d, B)), 1.e-13);
+      }
+}
+
+TEST(TraceKernels, SparseScaledGemm) {
+  std::mt19937 gen(1011);
+  std::bernoulli_distribution nonzero(0.2);
+  for (int n1 : dims)
+    for (int n2 : dims)
+      for (int k : dims) {
+        // A sparse n1 x k matrix, as the operator matrices of atom_diag
+        auto A = random_matrix(n1, k, gen);
+        for (auto& x : A)
+          if (!nonzero(gen)) x = 0;
+        matrix_t A_mat(n1, k);
+        for (int i = 0; i < n1; ++i)
+          for (int u = 0; u < k; ++u) A_mat(i, u) = A[i * k + u];
+        auto A_csr = make_csr_matrix(A_mat);
+        auto B = random_matrix(k, n2, gen);
+        auto d = random_diagonal(k, gen);
+        buffer_t C(long(n1) * n2);
+        kernels::sparse_scaled_gemm(A_csr, n2, d.data(), B.data(), C.data());
+        EXPECT_LT(max_difference(C, naive_product(n1, n2, k, A, d, B)), 1.e-13);
+      }
+}
+
+TEST(TraceKernels, ExpEvolution) {
+  std::mt19937 gen(1213);
+  std::uniform_real_distribution<double> energy(0, 20);
+  for (int n : dims)
+    for (double dtau : {0.0, 1.e-3, 0.7, 10.0}) {
+      std::vector<double> E(n), out(n);
+      for (auto& e : E) e = energy(gen);
+      kernels::exp_evolution(n, dtau, E.data(), out.data());
+      for (int i = 0; i < n; ++i) EXPECT_NEAR(out[i], std::exp(-dtau * E[i]), 1.e-15);
+    }
+}
+
+MAKE_MAIN;